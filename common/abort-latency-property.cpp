@@ -0,0 +1,61 @@
+#include "abort-latency-property.h"
+
+void CAbortLatencyProperty::Fill(const char *dev, const char *group, unsigned int alarmMs)
+{
+	IUFillNumber(&m_n[COUNT], "COUNT", "Aborts", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[FAILURES], "FAILURES", "Failures", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[LAST_MS], "LAST_MS", "Last (ms)", "%.2f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[MEAN_MS], "MEAN_MS", "Mean (ms)", "%.2f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[P99_MS], "P99_MS", "p99 (ms)", "%.2f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[MAX_MS], "MAX_MS", "Max (ms)", "%.2f", 0., 0., 0., 0.);
+	IUFillNumberVector(&m_nvp, m_n, ELEMENTS, dev, "ABORT_LATENCY", "Abort Latency", group, IP_RO, 0, IPS_IDLE);
+
+	m_alarmMs = alarmMs;
+	Reset();
+}
+
+void CAbortLatencyProperty::Define(INDI::DefaultDevice *device)
+{
+	device->defineNumber(&m_nvp);
+}
+
+void CAbortLatencyProperty::Delete(INDI::DefaultDevice *device)
+{
+	device->deleteProperty(m_nvp.name);
+}
+
+void CAbortLatencyProperty::Reset()
+{
+	m_failures = 0;
+	m_latency.Reset();
+
+	for (int i = 0; i < ELEMENTS; i++)
+	{
+		m_n[i].value = 0;
+	}
+
+	m_nvp.s = IPS_IDLE;
+}
+
+void CAbortLatencyProperty::Record(unsigned long long us, bool ok)
+{
+	if (ok)
+	{
+		m_latency.Record(us);
+
+		m_n[LAST_MS].value = us / 1000.;
+		m_n[MEAN_MS].value = m_latency.Mean() / 1000.;
+		m_n[P99_MS].value = m_latency.Percentile(0.99) / 1000.;
+		m_n[MAX_MS].value = m_latency.Max() / 1000.;
+	}
+	else
+	{
+		m_failures++;
+	}
+
+	m_n[COUNT].value = m_latency.Count() + m_failures;
+	m_n[FAILURES].value = m_failures;
+
+	m_nvp.s = (!ok || us > m_alarmMs * 1000ULL) ? IPS_ALERT : IPS_OK;
+	IDSetNumber(&m_nvp, NULL);
+}
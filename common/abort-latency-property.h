@@ -0,0 +1,34 @@
+#ifndef __ABORT_LATENCY_PROPERTY_H
+#define __ABORT_LATENCY_PROPERTY_H
+
+#include "defaultdevice.h"
+#include "latency-histogram.h"
+
+// Times every abort from the client's request to the stop command
+// landing on the bus, and publishes the distribution as one read-only
+// number vector.  The vector is in alert while the latest abort took
+// longer than the alarm threshold.
+class CAbortLatencyProperty
+{
+public:
+    void Fill(const char *dev, const char *group, unsigned int alarmMs);
+
+    void Define(INDI::DefaultDevice *device);
+    void Delete(INDI::DefaultDevice *device);
+
+    // Record one abort and send the vector; failed aborts only count
+    void Record(unsigned long long us, bool ok);
+    void Reset();
+
+private:
+    enum { COUNT, FAILURES, LAST_MS, MEAN_MS, P99_MS, MAX_MS, ELEMENTS };
+
+    INumber m_n[ELEMENTS];
+    INumberVectorProperty m_nvp;
+
+    unsigned int m_alarmMs;
+    unsigned long m_failures;
+    CLatencyHistogram m_latency;
+};
+
+#endif
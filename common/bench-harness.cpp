@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "bench-harness.h"
+#include "monotonic-clock.h"
+
+std::atomic<int> CBenchProbe::m_expected(-1);
+std::atomic<unsigned long long> CBenchProbe::m_busUs(0);
+
+static unsigned long long CpuUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+CBenchSeries::CBenchSeries(const char *name)
+{
+	m_name = name;
+	m_startUs = 0;
+	m_startCpuUs = 0;
+	m_cpuUs = 0;
+}
+
+void CBenchSeries::Begin()
+{
+	m_startCpuUs = CpuUs();
+	m_startUs = MonotonicUs();
+}
+
+void CBenchSeries::Done(unsigned long long busUs)
+{
+	unsigned long long now = MonotonicUs();
+
+	m_toBus.Record(busUs > m_startUs ? busUs - m_startUs : 0);
+	m_toDone.Record(now - m_startUs);
+	m_cpuUs += CpuUs() - m_startCpuUs;
+}
+
+void CBenchSeries::PrintHeader(FILE *fp)
+{
+	fprintf(fp, "%-10s %6s %10s %10s %10s %10s %10s %10s %10s\n", "operation", "n",
+	        "bus p50", "bus p99", "bus max", "done p50", "done p99", "done max", "cpu/op");
+	fprintf(fp, "%-10s %6s %10s %10s %10s %10s %10s %10s %10s\n", "", "",
+	        "(us)", "(us)", "(us)", "(us)", "(us)", "(us)", "(us)");
+}
+
+void CBenchSeries::Print(FILE *fp) const
+{
+	unsigned long n = m_toDone.Count();
+
+	fprintf(fp, "%-10s %6lu %10llu %10llu %10llu %10llu %10llu %10llu %10.1f\n", m_name, n,
+	        m_toBus.Percentile(0.5), m_toBus.Percentile(0.99), m_toBus.Max(),
+	        m_toDone.Percentile(0.5), m_toDone.Percentile(0.99), m_toDone.Max(),
+	        n ? (double)m_cpuUs / n : 0.);
+}
+
+void CBenchProbe::Expect(unsigned char command)
+{
+	m_busUs = 0;
+	m_expected = command;
+}
+
+void CBenchProbe::Seen(unsigned char command)
+{
+	unsigned long long unset = 0;
+
+	if (command == m_expected)
+	{
+		m_busUs.compare_exchange_strong(unset, MonotonicUs());
+	}
+}
+
+FILE *BenchOpenOutput()
+{
+	FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+
+	if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+		fprintf(stderr, "Could not silence driver output\n");
+	}
+
+	return out;
+}
+
+void BenchNumber(const char *dev, const char *name, const char *element, double value)
+{
+	double values[1] = { value };
+	char *names[1] = { (char *)element };
+
+	ISNewNumber(dev, name, values, names, 1);
+}
+
+void BenchSwitch(const char *dev, const char *name, const char *element)
+{
+	ISState states[1] = { ISS_ON };
+	char *names[1] = { (char *)element };
+
+	ISNewSwitch(dev, name, states, names, 1);
+}
+
+#define BENCH_TIMEOUT_MS 10000
+
+static INumberVectorProperty *Number(INDI::DefaultDevice *device, const char *name)
+{
+	INumberVectorProperty *nvp = NULL;
+
+	// Properties only exist once the driver is connected
+	BenchWaitFor([&]() { return (nvp = device->getNumber(name)) != NULL; }, BENCH_TIMEOUT_MS);
+
+	return nvp;
+}
+
+// Device state only reaches the properties from the driver's event
+// loop callbacks, which run on this thread.  Clearing the watched value
+// once the request has been handled means whatever the driver publishes
+// afterwards came from the device rather than from the request itself.
+static void Unseen(INumber *watch)
+{
+	watch->value = -1;
+}
+
+// Send a number and wait for the driver to publish the watched value as
+// read back from the device.
+static bool SetAndReadBack(CBenchSeries &series, const char *dev, const char *name, const char *element,
+                           unsigned char command, double value, INumber *watch)
+{
+	CBenchProbe::Expect(command);
+	series.Begin();
+
+	BenchNumber(dev, name, element, value);
+	Unseen(watch);
+
+	if (!BenchWaitFor([&]() { return CBenchProbe::BusUs() != 0 && watch->value == value; }, BENCH_TIMEOUT_MS))
+	{
+		return false;
+	}
+
+	series.Done(CBenchProbe::BusUs());
+	return true;
+}
+
+static bool Move(CBenchSeries *series, const char *dev, INumberVectorProperty *position, unsigned char command, double target)
+{
+	CBenchProbe::Expect(command);
+	if (series != NULL)
+	{
+		series->Begin();
+	}
+
+	BenchNumber(dev, position->name, "FOCUS_ABSOLUTE_POSITION", target);
+	Unseen(&position->np[0]);
+
+	if (!BenchWaitFor([&]() { return CBenchProbe::BusUs() != 0 && position->s == IPS_OK && position->np[0].value == target; }, BENCH_TIMEOUT_MS))
+	{
+		return false;
+	}
+
+	if (series != NULL)
+	{
+		series->Done(CBenchProbe::BusUs());
+	}
+	return true;
+}
+
+static bool Abort(CBenchSeries &series, const char *dev, INumberVectorProperty *position, const BENCH_COMMANDS &commands, double target)
+{
+	// Start a long move and wait until the device reports progress
+	double start = position->np[0].value;
+
+	CBenchProbe::Expect(commands.move);
+	BenchNumber(dev, position->name, "FOCUS_ABSOLUTE_POSITION", target);
+	Unseen(&position->np[0]);
+
+	if (!BenchWaitFor([&]() { return CBenchProbe::BusUs() != 0 && position->s == IPS_BUSY &&
+	                                 position->np[0].value != -1 && position->np[0].value != start; }, BENCH_TIMEOUT_MS))
+	{
+		return false;
+	}
+
+	CBenchProbe::Expect(commands.abort);
+	series.Begin();
+
+	BenchSwitch(dev, "FOCUS_ABORT_MOTION", "ABORT");
+
+	if (!BenchWaitFor([&]() { return CBenchProbe::BusUs() != 0 && position->s == IPS_OK; }, BENCH_TIMEOUT_MS))
+	{
+		return false;
+	}
+
+	series.Done(CBenchProbe::BusUs());
+	return true;
+}
+
+int BenchRun(INDI::DefaultDevice *device, const BENCH_COMMANDS &commands, int iterations, FILE *out)
+{
+	const char *dev = device->getDeviceName();
+
+	CBenchSeries move("move");
+	CBenchSeries sync("sync");
+	CBenchSeries abort("abort");
+	CBenchSeries prefs("prefs");
+
+	INumberVectorProperty *position = Number(device, "ABS_FOCUS_POSITION");
+	INumberVectorProperty *backlash = Number(device, "FOCUS_BACKLASH_STEPS");
+
+	if (position == NULL || backlash == NULL)
+	{
+		fprintf(out, "Device %s did not define its focuser properties\n", dev);
+		return iterations * 4;
+	}
+
+	int failed = 0;
+	double home = 10000;
+
+	// Settle at a known position first
+	if (!Move(NULL, dev, position, commands.move, home))
+	{
+		fprintf(out, "Device %s did not reach %.f\n", dev, home);
+		return iterations * 4;
+	}
+
+	for (int i = 0; i < iterations; i++)
+	{
+		double there = home + ((i & 1) ? -100 : 100);
+
+		failed += !Move(&move, dev, position, commands.move, there);
+		failed += !Move(NULL, dev, position, commands.move, home);
+
+		// A sync shows up as the new absolute position
+		failed += !SetAndReadBack(sync, dev, "FOCUS_SYNC", "FOCUS_SYNC_VALUE", commands.sync, home + 1, &position->np[0]);
+		failed += !SetAndReadBack(sync, dev, "FOCUS_SYNC", "FOCUS_SYNC_VALUE", commands.sync, home, &position->np[0]);
+
+		failed += !SetAndReadBack(prefs, dev, backlash->name, "FOCUS_BACKLASH_VALUE", commands.prefs, (i & 1) ? 20 : 40, &backlash->np[0]);
+
+		failed += !Abort(abort, dev, position, commands, (i & 1) ? home - 5000 : home + 5000);
+		failed += !Move(NULL, dev, position, commands.move, home);
+	}
+
+	CBenchSeries::PrintHeader(out);
+	move.Print(out);
+	sync.Print(out);
+	abort.Print(out);
+	prefs.Print(out);
+
+	if (failed)
+	{
+		fprintf(out, "%d requests timed out after %d ms\n", failed, BENCH_TIMEOUT_MS);
+	}
+
+	return failed;
+}
@@ -0,0 +1,92 @@
+
+#ifndef __BENCH_HARNESS_H
+#define __BENCH_HARNESS_H
+
+#include <stdio.h>
+#include <atomic>
+
+#include "indidevapi.h"
+#include "defaultdevice.h"
+#include "eventloop.h"
+#include "latency-histogram.h"
+
+// Latency and CPU cost of one kind of client request, measured from the
+// INDI entry point to the command reaching the (simulated) bus and to
+// the driver reporting it complete.
+class CBenchSeries
+{
+public:
+    CBenchSeries(const char *name);
+
+    void Begin();
+    void Done(unsigned long long busUs);
+
+    void Print(FILE *fp) const;
+    static void PrintHeader(FILE *fp);
+
+private:
+    const char *m_name;
+
+    CLatencyHistogram m_toBus;
+    CLatencyHistogram m_toDone;
+
+    unsigned long long m_startUs;
+    unsigned long long m_startCpuUs;
+    unsigned long long m_cpuUs;
+};
+
+// Simulator probes report here when the command a series is waiting
+// for reaches the device.  Seen may run on whichever thread drives the
+// bus, so it only records the time; the driver's properties are left to
+// the INDI thread.
+class CBenchProbe
+{
+public:
+    static void Expect(unsigned char command);
+    static void Seen(unsigned char command);
+    static unsigned long long BusUs() { return m_busUs; }
+
+private:
+    static std::atomic<int> m_expected;
+    static std::atomic<unsigned long long> m_busUs;
+};
+
+// Run the INDI event loop until the condition holds or the timeout
+// passes.  Returns false on timeout.
+template <typename F>
+bool BenchWaitFor(F condition, int timeoutMs)
+{
+    for (int waited = 0; !condition(); waited++)
+    {
+        if (waited >= timeoutMs)
+        {
+            return false;
+        }
+
+        int never = 0;
+        IEDeferLoop(1, &never);
+    }
+
+    return true;
+}
+
+// The bus command each benchmarked request ends up as on the device.
+typedef struct _bench_commands {
+    unsigned char move;
+    unsigned char sync;
+    unsigned char abort;
+    unsigned char prefs;
+} BENCH_COMMANDS;
+
+// Run every series against a connected device and print the results.
+// Returns the number of requests that did not complete in time.
+int BenchRun(INDI::DefaultDevice *device, const BENCH_COMMANDS &commands, int iterations, FILE *out);
+
+// Redirect the driver's XML on stdout to /dev/null and return a stream
+// for the results.
+FILE *BenchOpenOutput();
+
+void BenchNumber(const char *dev, const char *name, const char *element, double value);
+void BenchSwitch(const char *dev, const char *name, const char *element);
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdio.h>
+
+#include "bus-stats-property.h"
+
+void CBusStatsProperty::Fill(const char *dev, const char *group, const BUS_OPCODE *opcodes)
+{
+	size_t count = 0;
+	while (opcodes[count].name != NULL)
+	{
+		count++;
+	}
+
+	// The vectors point into their own elements, so size the storage
+	// once and never let it move.
+	m_vectors.clear();
+	m_vectors.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		VECTOR &v = m_vectors[i];
+
+		v.opcode = opcodes[i].opcode;
+		v.published = 0;
+		snprintf(v.name, sizeof(v.name), "BUS_%s", opcodes[i].name);
+		snprintf(v.label, sizeof(v.label), "%s (0x%02X)", opcodes[i].label, opcodes[i].opcode);
+
+		IUFillNumber(&v.n[COUNT], "COUNT", "Transactions", "%.f", 0., 0., 0., 0.);
+		IUFillNumber(&v.n[RETRIES], "RETRIES", "Retries", "%.f", 0., 0., 0., 0.);
+		IUFillNumber(&v.n[FAILURES], "FAILURES", "Failures", "%.f", 0., 0., 0., 0.);
+		IUFillNumber(&v.n[MEAN_US], "MEAN_US", "Mean (us)", "%.f", 0., 0., 0., 0.);
+		IUFillNumber(&v.n[P50_US], "P50_US", "p50 (us)", "%.f", 0., 0., 0., 0.);
+		IUFillNumber(&v.n[P99_US], "P99_US", "p99 (us)", "%.f", 0., 0., 0., 0.);
+		IUFillNumber(&v.n[MAX_US], "MAX_US", "Max (us)", "%.f", 0., 0., 0., 0.);
+		IUFillNumberVector(&v.nvp, v.n, ELEMENTS, dev, v.name, v.label, group, IP_RO, 0, IPS_IDLE);
+	}
+}
+
+void CBusStatsProperty::Define(INDI::DefaultDevice *device)
+{
+	for (size_t i = 0; i < m_vectors.size(); i++)
+	{
+		device->defineNumber(&m_vectors[i].nvp);
+	}
+}
+
+void CBusStatsProperty::Delete(INDI::DefaultDevice *device)
+{
+	for (size_t i = 0; i < m_vectors.size(); i++)
+	{
+		device->deleteProperty(m_vectors[i].nvp.name);
+	}
+}
+
+void CBusStatsProperty::Publish(const CBusStats &stats)
+{
+	CBusStats::OPCODE_STATS opcode;
+
+	for (size_t i = 0; i < m_vectors.size(); i++)
+	{
+		VECTOR &v = m_vectors[i];
+
+		if (!stats.Get(v.opcode, opcode) || opcode.count == v.published)
+		{
+			continue;
+		}
+
+		v.published = opcode.count;
+
+		v.n[COUNT].value = opcode.count;
+		v.n[RETRIES].value = opcode.retries;
+		v.n[FAILURES].value = opcode.failures;
+		v.n[MEAN_US].value = opcode.latency.Mean();
+		v.n[P50_US].value = opcode.latency.Percentile(0.5);
+		v.n[P99_US].value = opcode.latency.Percentile(0.99);
+		v.n[MAX_US].value = opcode.latency.Max();
+
+		// Alert until a transaction of this opcode succeeds again
+		v.nvp.s = opcode.lastFailed ? IPS_ALERT : IPS_OK;
+		IDSetNumber(&v.nvp, NULL);
+	}
+}
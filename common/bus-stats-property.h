@@ -0,0 +1,45 @@
+
+#ifndef __BUS_STATS_PROPERTY_H
+#define __BUS_STATS_PROPERTY_H
+
+#include <vector>
+
+#include "defaultdevice.h"
+#include "bus-stats.h"
+
+typedef struct _bus_opcode {
+    unsigned int opcode;
+    const char *name;
+    const char *label;
+} BUS_OPCODE;
+
+// Publishes CBusStats as one read-only number vector per opcode, so a
+// degrading bus shows up in any INDI client.
+class CBusStatsProperty
+{
+public:
+    // The opcode table ends with an entry whose name is NULL
+    void Fill(const char *dev, const char *group, const BUS_OPCODE *opcodes);
+
+    void Define(INDI::DefaultDevice *device);
+    void Delete(INDI::DefaultDevice *device);
+
+    // Send the vectors whose opcodes saw traffic since the last call
+    void Publish(const CBusStats &stats);
+
+private:
+    enum { COUNT, RETRIES, FAILURES, MEAN_US, P50_US, P99_US, MAX_US, ELEMENTS };
+
+    typedef struct _vector {
+        unsigned int opcode;
+        unsigned long published;
+        char name[MAXINDINAME];
+        char label[MAXINDILABEL];
+        INumber n[ELEMENTS];
+        INumberVectorProperty nvp;
+    } VECTOR;
+
+    std::vector<VECTOR> m_vectors;
+};
+
+#endif
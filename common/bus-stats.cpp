@@ -0,0 +1,67 @@
+#include "bus-stats.h"
+
+CBusStats::CBusStats()
+{
+	pthread_mutex_init(&m_lock, NULL);
+}
+
+CBusStats::~CBusStats()
+{
+	pthread_mutex_destroy(&m_lock);
+}
+
+void CBusStats::Record(unsigned int opcode, unsigned long long us, bool ok)
+{
+	pthread_mutex_lock(&m_lock);
+
+	// Only the first transaction of an opcode allocates
+	std::map<unsigned int, OPCODE_STATS>::iterator it = m_opcodes.find(opcode);
+	if (it == m_opcodes.end())
+	{
+		OPCODE_STATS fresh;
+		fresh.count = 0;
+		fresh.retries = 0;
+		fresh.failures = 0;
+		fresh.lastFailed = false;
+		it = m_opcodes.insert(std::make_pair(opcode, fresh)).first;
+	}
+
+	OPCODE_STATS &stats = it->second;
+
+	stats.count++;
+	if (stats.lastFailed)
+	{
+		stats.retries++;
+	}
+	if (!ok)
+	{
+		stats.failures++;
+	}
+	stats.lastFailed = !ok;
+	stats.latency.Record(us);
+
+	pthread_mutex_unlock(&m_lock);
+}
+
+bool CBusStats::Get(unsigned int opcode, OPCODE_STATS &stats) const
+{
+	pthread_mutex_lock(&m_lock);
+
+	std::map<unsigned int, OPCODE_STATS>::const_iterator it = m_opcodes.find(opcode);
+	bool found = it != m_opcodes.end();
+	if (found)
+	{
+		stats = it->second;
+	}
+
+	pthread_mutex_unlock(&m_lock);
+
+	return found;
+}
+
+void CBusStats::Reset()
+{
+	pthread_mutex_lock(&m_lock);
+	m_opcodes.clear();
+	pthread_mutex_unlock(&m_lock);
+}
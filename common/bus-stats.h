@@ -0,0 +1,39 @@
+
+#ifndef __BUS_STATS_H
+#define __BUS_STATS_H
+
+#include <pthread.h>
+#include <map>
+
+#include "latency-histogram.h"
+
+// Count, retries, failures and latency of every bus transaction, kept per
+// command opcode.  Safe to record from several threads.
+class CBusStats
+{
+public:
+    CBusStats();
+    ~CBusStats();
+
+    typedef struct _opcode_stats {
+        unsigned long count;
+        unsigned long retries;
+        unsigned long failures;
+        bool lastFailed;
+        CLatencyHistogram latency;
+    } OPCODE_STATS;
+
+    // A transaction that follows a failure of the same opcode is counted
+    // as a retry, whoever made it.
+    void Record(unsigned int opcode, unsigned long long us, bool ok);
+
+    // Copy one opcode's numbers out.  Returns false if it was never seen.
+    bool Get(unsigned int opcode, OPCODE_STATS &stats) const;
+    void Reset();
+
+private:
+    mutable pthread_mutex_t m_lock;
+    std::map<unsigned int, OPCODE_STATS> m_opcodes;
+};
+
+#endif
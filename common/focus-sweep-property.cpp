@@ -0,0 +1,128 @@
+#include <string.h>
+#include <time.h>
+
+#include "focus-sweep-property.h"
+
+CFocusSweepProperty::CFocusSweepProperty()
+{
+	memset(m_positions, 0, sizeof(m_positions));
+}
+
+void CFocusSweepProperty::Fill(const char *dev, const char *group)
+{
+	IUFillText(&m_positions[0], "POSITIONS", "Positions", "");
+	IUFillTextVector(&m_positionsTP, m_positions, 1, dev, "SWEEP_POSITIONS", "Sweep", group, IP_RW, 0, IPS_IDLE);
+
+	IUFillNumber(&m_settings[OVERSHOOT], "OVERSHOOT", "Lead-in overshoot", "%.f", 0., 10000., 10., 100.);
+	IUFillNumber(&m_settings[SETTLE_MS], "SETTLE_MS", "Settle (ms)", "%.f", 0., 10000., 50., 0.);
+	IUFillNumberVector(&m_settingsNP, m_settings, SETTINGS, dev, "SWEEP_SETTINGS", "Sweep Settings", group, IP_RW, 0, IPS_IDLE);
+
+	IUFillSwitch(&m_approach[0], "INCREASING", "Increasing", ISS_ON);
+	IUFillSwitch(&m_approach[1], "DECREASING", "Decreasing", ISS_OFF);
+	IUFillSwitchVector(&m_approachSP, m_approach, 2, dev, "SWEEP_APPROACH", "Sweep Approach", group, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+	IUFillNumber(&m_point[INDEX], "INDEX", "Sample", "%.f", 0., CFocusSweep::MAX_POINTS, 0., 0.);
+	IUFillNumber(&m_point[POSITION], "POSITION", "Position", "%.f", 0., 65535., 0., 0.);
+	IUFillNumber(&m_point[TIME], "TIME", "Arrived (s)", "%.3f", 0., 0., 0., 0.);
+	IUFillNumberVector(&m_pointNP, m_point, POINT, dev, "SWEEP_POINT", "Sweep Point", group, IP_RO, 0, IPS_IDLE);
+}
+
+void CFocusSweepProperty::Define(INDI::DefaultDevice *device)
+{
+	device->defineText(&m_positionsTP);
+	device->defineNumber(&m_settingsNP);
+	device->defineSwitch(&m_approachSP);
+	device->defineNumber(&m_pointNP);
+}
+
+void CFocusSweepProperty::Delete(INDI::DefaultDevice *device)
+{
+	device->deleteProperty(m_positionsTP.name);
+	device->deleteProperty(m_settingsNP.name);
+	device->deleteProperty(m_approachSP.name);
+	device->deleteProperty(m_pointNP.name);
+}
+
+void CFocusSweepProperty::Save(FILE *fp)
+{
+	IUSaveConfigNumber(fp, &m_settingsNP);
+	IUSaveConfigSwitch(fp, &m_approachSP);
+}
+
+bool CFocusSweepProperty::ISNewText(const char *name, char *texts[], char *names[], int n, CFocusSweep &sweep,
+									unsigned int current, unsigned int maxPosition, bool &started)
+{
+	started = false;
+
+	if (strcmp(name, m_positionsTP.name) != 0)
+	{
+		return false;
+	}
+
+	IUUpdateText(&m_positionsTP, texts, names, n);
+
+	unsigned int positions[CFocusSweep::MAX_POINTS];
+	int count = CFocusSweep::Parse(m_positions[0].text, positions, CFocusSweep::MAX_POINTS);
+	bool increasing = m_approach[0].s == ISS_ON;
+
+	if (count < 1 || !sweep.Plan(positions, count, current, increasing, (unsigned int)m_settings[OVERSHOOT].value, maxPosition))
+	{
+		m_positionsTP.s = IPS_ALERT;
+		IDSetText(&m_positionsTP, "Sweep needs 1 to %d positions between 0 and %u", (int)CFocusSweep::MAX_POINTS, maxPosition);
+		return true;
+	}
+
+	started = true;
+
+	m_positionsTP.s = IPS_BUSY;
+	IDSetText(&m_positionsTP, "Sweeping %d positions, %u steps of travel", sweep.Samples(), sweep.Travel());
+	return true;
+}
+
+bool CFocusSweepProperty::ISNewNumber(const char *name, double values[], char *names[], int n)
+{
+	if (strcmp(name, m_settingsNP.name) != 0)
+	{
+		return false;
+	}
+
+	IUUpdateNumber(&m_settingsNP, values, names, n);
+	m_settingsNP.s = IPS_OK;
+	IDSetNumber(&m_settingsNP, NULL);
+
+	return true;
+}
+
+bool CFocusSweepProperty::ISNewSwitch(const char *name, ISState *states, char *names[], int n)
+{
+	if (strcmp(name, m_approachSP.name) != 0)
+	{
+		return false;
+	}
+
+	IUUpdateSwitch(&m_approachSP, states, names, n);
+	m_approachSP.s = IPS_OK;
+	IDSetSwitch(&m_approachSP, NULL);
+
+	return true;
+}
+
+void CFocusSweepProperty::Arrived(const CFocusSweep &sweep)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	m_point[INDEX].value = sweep.Sample();
+	m_point[POSITION].value = sweep.Target();
+	m_point[TIME].value = now.tv_sec + now.tv_nsec / 1e9;
+	m_pointNP.s = IPS_OK;
+
+	// Every arrival is an event, so this never goes through a shadow
+	IDSetNumber(&m_pointNP, "Sweep sample %d of %d at %u", sweep.Sample() + 1, sweep.Samples(), sweep.Target());
+}
+
+void CFocusSweepProperty::Finished(IPState state)
+{
+	m_positionsTP.s = state;
+	IDSetText(&m_positionsTP, NULL);
+}
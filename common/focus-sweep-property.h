@@ -0,0 +1,58 @@
+
+#ifndef __FOCUS_SWEEP_PROPERTY_H
+#define __FOCUS_SWEEP_PROPERTY_H
+
+#include <stdio.h>
+
+#include "defaultdevice.h"
+#include "focus-sweep.h"
+
+// The client side of a CFocusSweep.  Writing SWEEP_POSITIONS plans and
+// starts a sweep, SWEEP_SETTINGS and SWEEP_APPROACH shape the next one,
+// and SWEEP_POINT is sent with the wall clock time as each sample is
+// reached.  Driving the focuser and spotting arrival is up to the driver.
+class CFocusSweepProperty
+{
+public:
+    CFocusSweepProperty();
+
+    void Fill(const char *dev, const char *group);
+
+    void Define(INDI::DefaultDevice *device);
+    void Delete(INDI::DefaultDevice *device);
+    void Save(FILE *fp);
+
+    // True if the name is one of the sweep's writable properties; a new
+    // list of positions is planned into sweep.  started says whether
+    // there is now a sweep for the driver to begin.
+    bool ISNewText(const char *name, char *texts[], char *names[], int n, CFocusSweep &sweep,
+                   unsigned int current, unsigned int maxPosition, bool &started);
+    bool ISNewNumber(const char *name, double values[], char *names[], int n);
+    bool ISNewSwitch(const char *name, ISState *states, char *names[], int n);
+
+    unsigned int SettleMs() const { return (unsigned int)m_settings[SETTLE_MS].value; }
+    const char *PositionsName() const { return m_positionsTP.name; }
+
+    // The sweep has settled on its current sample
+    void Arrived(const CFocusSweep &sweep);
+    // Complete, aborted or failed; the positions show the outcome
+    void Finished(IPState state);
+
+private:
+    enum { OVERSHOOT, SETTLE_MS, SETTINGS };
+    enum { INDEX, POSITION, TIME, POINT };
+
+    IText m_positions[1];
+    ITextVectorProperty m_positionsTP;
+
+    INumber m_settings[SETTINGS];
+    INumberVectorProperty m_settingsNP;
+
+    ISwitch m_approach[2];
+    ISwitchVectorProperty m_approachSP;
+
+    INumber m_point[POINT];
+    INumberVectorProperty m_pointNP;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
+#include <functional>
+
+#include "focus-sweep.h"
+
+CFocusSweep::CFocusSweep()
+{
+	m_steps = 0;
+	m_next = 0;
+	m_travel = 0;
+}
+
+int CFocusSweep::Parse(const char *text, unsigned int positions[], int max)
+{
+	int count = 0;
+	const char *p = text;
+
+	while (*p)
+	{
+		if (isspace((unsigned char)*p) || *p == ',')
+		{
+			p++;
+			continue;
+		}
+
+		if (!isdigit((unsigned char)*p) || count == max)
+		{
+			return -1;
+		}
+
+		char *end;
+		unsigned long value = strtoul(p, &end, 10);
+		if (value > 0xFFFFFFFFUL)
+		{
+			return -1;
+		}
+
+		positions[count++] = (unsigned int)value;
+		p = end;
+	}
+
+	return count;
+}
+
+bool CFocusSweep::Plan(const unsigned int positions[], int count, unsigned int current, bool increasing,
+					   unsigned int overshoot, unsigned int maxPosition)
+{
+	Cancel();
+
+	if (count < 1 || count > MAX_POINTS)
+	{
+		return false;
+	}
+
+	unsigned int *samples = m_targets + 1;
+	std::copy(positions, positions + count, samples);
+
+	if (increasing)
+	{
+		std::sort(samples, samples + count);
+	}
+	else
+	{
+		std::sort(samples, samples + count, std::greater<unsigned int>());
+	}
+
+	count = std::unique(samples, samples + count) - samples;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (samples[i] > maxPosition)
+		{
+			return false;
+		}
+	}
+
+	// Start from beyond the first sample unless already coming from there
+	unsigned int first = samples[0];
+	bool wrongSide = increasing ? current >= first : current <= first;
+
+	if (wrongSide)
+	{
+		unsigned int lead;
+		if (increasing)
+		{
+			lead = first > overshoot ? first - overshoot : 0;
+		}
+		else
+		{
+			lead = maxPosition - first > overshoot ? first + overshoot : maxPosition;
+		}
+
+		// Only worth it if it does not land on the sample itself
+		wrongSide = lead != first;
+		m_targets[0] = lead;
+	}
+
+	m_next = wrongSide ? 0 : 1;
+	m_steps = count + 1;
+
+	unsigned int from = current;
+	m_travel = 0;
+	for (int i = m_next; i < m_steps; i++)
+	{
+		m_travel += m_targets[i] > from ? m_targets[i] - from : from - m_targets[i];
+		from = m_targets[i];
+	}
+
+	return true;
+}
+
+void CFocusSweep::Cancel()
+{
+	m_steps = 0;
+	m_next = 0;
+	m_travel = 0;
+}
+
+bool CFocusSweep::Advance()
+{
+	if (!Active())
+	{
+		return false;
+	}
+
+	m_next++;
+	return Active();
+}
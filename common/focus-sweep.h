@@ -0,0 +1,53 @@
+
+#ifndef __FOCUS_SWEEP_H
+#define __FOCUS_SWEEP_H
+
+// Plans and tracks an autofocus sweep: a list of sample positions
+// visited in order of position, so every sample is approached from the
+// same side and the gear backlash is taken up once rather than at every
+// reversal.  When the focuser starts on the wrong side of the first
+// sample, a lead-in move past it by the overshoot comes first.
+class CFocusSweep
+{
+public:
+    enum { MAX_POINTS = 64 };
+
+    CFocusSweep();
+
+    // Parses a list of positions separated by commas or spaces.  Returns
+    // the number found, or -1 if the text holds anything else or more
+    // than max positions.
+    static int Parse(const char *text, unsigned int positions[], int max);
+
+    // Duplicates are dropped.  False if there is nothing to visit or a
+    // position is beyond maxPosition.
+    bool Plan(const unsigned int positions[], int count, unsigned int current, bool increasing,
+              unsigned int overshoot, unsigned int maxPosition);
+    void Cancel();
+
+    bool Active() const { return m_next < m_steps; }
+
+    // The position being moved to, and whether it is a sample or the
+    // lead-in
+    unsigned int Target() const { return m_targets[m_next]; }
+    bool AtSample() const { return m_next > 0; }
+
+    // Zero based index of the current sample among Samples()
+    int Sample() const { return m_next - 1; }
+    int Samples() const { return m_steps > 0 ? m_steps - 1 : 0; }
+
+    // Steps the whole plan travels from where it started
+    unsigned int Travel() const { return m_travel; }
+
+    // Move on to the next target; false when the sweep is complete
+    bool Advance();
+
+private:
+    // The lead-in, then the samples in visiting order
+    unsigned int m_targets[MAX_POINTS + 1];
+    int m_steps;
+    int m_next;
+    unsigned int m_travel;
+};
+
+#endif
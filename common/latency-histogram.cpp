@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "latency-histogram.h"
+
+CLatencyHistogram::CLatencyHistogram()
+{
+	Reset();
+}
+
+void CLatencyHistogram::Reset()
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+	m_count = 0;
+	m_sum = 0;
+	m_max = 0;
+}
+
+int CLatencyHistogram::Bucket(unsigned long long us)
+{
+	if (us < LINEAR)
+	{
+		return us;
+	}
+
+	int exponent = 63 - __builtin_clzll(us);
+	int sub = (us >> (exponent - SUB_BITS)) & (SUB - 1);
+	int bucket = LINEAR + (exponent - 4) * SUB + sub;
+
+	return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+unsigned long long CLatencyHistogram::UpperBound(int bucket)
+{
+	if (bucket < LINEAR)
+	{
+		return bucket;
+	}
+
+	int exponent = (bucket - LINEAR) / SUB + 4;
+	int sub = (bucket - LINEAR) % SUB;
+
+	return (1ULL << exponent) + ((unsigned long long)(sub + 1) << (exponent - SUB_BITS)) - 1;
+}
+
+void CLatencyHistogram::Record(unsigned long long us)
+{
+	m_buckets[Bucket(us)]++;
+	m_count++;
+	m_sum += us;
+
+	if (us > m_max)
+	{
+		m_max = us;
+	}
+}
+
+double CLatencyHistogram::Mean() const
+{
+	return m_count ? (double)m_sum / m_count : 0.;
+}
+
+unsigned long long CLatencyHistogram::Percentile(double fraction) const
+{
+	if (m_count == 0)
+	{
+		return 0;
+	}
+
+	unsigned long target = (unsigned long)(fraction * m_count + 0.5);
+	if (target == 0)
+	{
+		target = 1;
+	}
+
+	unsigned long seen = 0;
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		seen += m_buckets[i];
+		if (seen >= target)
+		{
+			unsigned long long bound = UpperBound(i);
+			return bound < m_max ? bound : m_max;
+		}
+	}
+
+	return m_max;
+}
@@ -0,0 +1,36 @@
+
+#ifndef __LATENCY_HISTOGRAM_H
+#define __LATENCY_HISTOGRAM_H
+
+// Fixed size log-linear histogram of microsecond latencies.  Values
+// below 16us get their own bucket; above that each power of two is
+// split into 8 buckets, so any percentile is within 12.5%.  Recording
+// never allocates.
+class CLatencyHistogram
+{
+public:
+    CLatencyHistogram();
+
+    void Record(unsigned long long us);
+    void Reset();
+
+    unsigned long Count() const { return m_count; }
+    unsigned long long Max() const { return m_max; }
+    double Mean() const;
+
+    // Upper bound of the bucket holding the given fraction, 0 to 1.
+    unsigned long long Percentile(double fraction) const;
+
+private:
+    enum { LINEAR = 16, SUB_BITS = 3, SUB = 1 << SUB_BITS, EXPONENTS = 36, BUCKETS = LINEAR + EXPONENTS * SUB };
+
+    unsigned long m_buckets[BUCKETS];
+    unsigned long m_count;
+    unsigned long long m_sum;
+    unsigned long long m_max;
+
+    static int Bucket(unsigned long long us);
+    static unsigned long long UpperBound(int bucket);
+};
+
+#endif
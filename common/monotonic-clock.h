@@ -0,0 +1,20 @@
+
+#ifndef __MONOTONIC_CLOCK_H
+#define __MONOTONIC_CLOCK_H
+
+#include <time.h>
+
+static inline unsigned long long MonotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline unsigned long long MonotonicMs()
+{
+    return MonotonicUs() / 1000;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "motion-estimate-property.h"
+#include "monotonic-clock.h"
+
+#define ESTIMATE_PERIOD_MS 100
+
+CMotionEstimateProperty::CMotionEstimateProperty()
+{
+	m_shadow = NULL;
+	m_state = NULL;
+	m_arg = NULL;
+	m_timer = -1;
+}
+
+CMotionEstimateProperty::~CMotionEstimateProperty()
+{
+	Stop();
+}
+
+void CMotionEstimateProperty::Fill(const char *dev, const char *group, CPropertyShadow &shadow, StateFn state, void *arg)
+{
+	IUFillNumber(&m_n[POSITION], "POSITION", "Position (est.)", "%.f", 0., 65535., 0., 0.);
+	IUFillNumber(&m_n[ETA_MS], "ETA_MS", "Arrival (ms)", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[RATE], "RATE", "Rate (steps/s)", "%.1f", 0., 0., 0., 0.);
+	IUFillNumberVector(&m_nvp, m_n, ELEMENTS, dev, "FOCUS_ESTIMATE", "Estimate", group, IP_RO, 0, IPS_IDLE);
+
+	m_shadow = &shadow;
+	m_state = state;
+	m_arg = arg;
+}
+
+void CMotionEstimateProperty::Define(INDI::DefaultDevice *device)
+{
+	device->defineNumber(&m_nvp);
+}
+
+void CMotionEstimateProperty::Delete(INDI::DefaultDevice *device)
+{
+	device->deleteProperty(m_nvp.name);
+}
+
+void CMotionEstimateProperty::Start()
+{
+	if (m_timer != -1)
+	{
+		return;
+	}
+
+	Publish();
+}
+
+void CMotionEstimateProperty::Stop()
+{
+	if (m_timer != -1)
+	{
+		IERmTimer(m_timer);
+		m_timer = -1;
+	}
+}
+
+void CMotionEstimateProperty::Timeout(void *p)
+{
+	CMotionEstimateProperty *property = (CMotionEstimateProperty *)p;
+
+	property->m_timer = -1;
+	property->Publish();
+}
+
+void CMotionEstimateProperty::Publish()
+{
+	MOTION_STATE state;
+	if (m_state == NULL || !m_state(m_arg, state))
+	{
+		return;
+	}
+
+	CMotionModel::MOTION_ESTIMATE estimate;
+	if (state.moving && state.model->Estimate(MonotonicUs(), estimate))
+	{
+		m_n[POSITION].value = estimate.position;
+		m_n[ETA_MS].value = estimate.etaMs;
+		m_n[RATE].value = estimate.rate;
+		m_nvp.s = IPS_BUSY;
+		m_shadow->SetNumber(&m_nvp);
+
+		m_timer = IEAddTimer(ESTIMATE_PERIOD_MS, Timeout, this);
+		return;
+	}
+
+	m_n[POSITION].value = state.position;
+	m_n[ETA_MS].value = 0;
+	m_n[RATE].value = state.model->Rate(state.key);
+	m_nvp.s = state.moving ? IPS_BUSY : IPS_OK;
+	m_shadow->SetNumber(&m_nvp);
+}
@@ -0,0 +1,56 @@
+#ifndef __MOTION_ESTIMATE_PROPERTY_H
+#define __MOTION_ESTIMATE_PROPERTY_H
+
+#include "defaultdevice.h"
+#include "motion-model.h"
+#include "property-shadow.h"
+
+// Publishes a CMotionModel's estimate as FOCUS_ESTIMATE.  Samples only
+// come as often as the device reports or is polled, so while the
+// focuser moves the estimate is resent on a timer of its own.  Stopped,
+// or before the rate for the current speed is learned, it shows the
+// last real position.
+class CMotionEstimateProperty
+{
+public:
+    // The driver's view of the focuser, asked for on every publish
+    typedef struct _motion_state {
+        const CMotionModel *model;
+        unsigned int position;
+        // Speed setting, as passed to CMotionModel::Sample
+        unsigned int key;
+        bool moving;
+    } MOTION_STATE;
+
+    // False while there is nothing to publish, e.g. disconnected
+    typedef bool (*StateFn)(void *arg, MOTION_STATE &state);
+
+    CMotionEstimateProperty();
+    ~CMotionEstimateProperty();
+
+    void Fill(const char *dev, const char *group, CPropertyShadow &shadow, StateFn state, void *arg);
+
+    void Define(INDI::DefaultDevice *device);
+    void Delete(INDI::DefaultDevice *device);
+
+    // Publish now, and keep publishing while the focuser moves.  Does
+    // nothing while the timer is already running.
+    void Start();
+    void Stop();
+
+private:
+    enum { POSITION, ETA_MS, RATE, ELEMENTS };
+
+    INumber m_n[ELEMENTS];
+    INumberVectorProperty m_nvp;
+
+    CPropertyShadow *m_shadow;
+    StateFn m_state;
+    void *m_arg;
+    int m_timer;
+
+    static void Timeout(void *p);
+    void Publish();
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "motion-model.h"
+
+// Weight of each new rate measurement
+#define RATE_ALPHA			0.25
+// Shorter intervals are too coarse to learn a rate from
+#define MIN_INTERVAL_US		5000
+
+CMotionModel::CMotionModel()
+{
+	pthread_mutex_init(&m_lock, NULL);
+
+	for (int i = 0; i < KEYS; i++)
+	{
+		m_rates[i] = 0;
+	}
+
+	m_anchorUs = 0;
+	m_anchorPosition = 0;
+
+	m_moving = false;
+	m_lastUs = 0;
+	m_lastPosition = 0;
+	m_target = 0;
+	m_key = 0;
+}
+
+CMotionModel::~CMotionModel()
+{
+	pthread_mutex_destroy(&m_lock);
+}
+
+void CMotionModel::Sample(unsigned long long us, unsigned int position, unsigned int target, bool moving, unsigned int key)
+{
+	key %= KEYS;
+
+	pthread_mutex_lock(&m_lock);
+
+	// Only samples of the same move at the same speed give a rate; the
+	// first of a move only anchors it, as its interval includes the
+	// command latency.  Samples closer than the minimum interval are
+	// measured from the anchor instead.
+	if (!(m_moving && moving && key == m_key && target == m_target))
+	{
+		m_anchorUs = us;
+		m_anchorPosition = position;
+	}
+	else if (us - m_anchorUs >= MIN_INTERVAL_US)
+	{
+		unsigned int steps = position > m_anchorPosition ? position - m_anchorPosition : m_anchorPosition - position;
+		bool towards = (target > m_anchorPosition) == (position > m_anchorPosition);
+
+		if (steps > 0 && towards)
+		{
+			double rate = steps * 1000000.0 / (us - m_anchorUs);
+			double &learned = m_rates[key];
+
+			learned = learned == 0 ? rate : learned + RATE_ALPHA * (rate - learned);
+		}
+
+		m_anchorUs = us;
+		m_anchorPosition = position;
+	}
+
+	m_moving = moving;
+	m_lastUs = us;
+	m_lastPosition = position;
+	m_target = target;
+	m_key = key;
+
+	pthread_mutex_unlock(&m_lock);
+}
+
+void CMotionModel::Stop()
+{
+	pthread_mutex_lock(&m_lock);
+	m_moving = false;
+	pthread_mutex_unlock(&m_lock);
+}
+
+bool CMotionModel::Estimate(unsigned long long us, MOTION_ESTIMATE &estimate) const
+{
+	pthread_mutex_lock(&m_lock);
+
+	double rate = m_rates[m_key];
+	bool known = m_moving && rate > 0;
+
+	if (known)
+	{
+		double elapsed = us > m_lastUs ? (us - m_lastUs) / 1000000.0 : 0;
+		unsigned int remaining = m_target > m_lastPosition ? m_target - m_lastPosition : m_lastPosition - m_target;
+
+		double travelled = rate * elapsed;
+		if (travelled > remaining)
+		{
+			travelled = remaining;
+		}
+
+		unsigned int steps = (unsigned int)travelled;
+		estimate.position = m_target > m_lastPosition ? m_lastPosition + steps : m_lastPosition - steps;
+		estimate.target = m_target;
+		estimate.etaMs = (unsigned int)((remaining - travelled) * 1000.0 / rate);
+		estimate.rate = rate;
+	}
+
+	pthread_mutex_unlock(&m_lock);
+
+	return known;
+}
+
+double CMotionModel::Rate(unsigned int key) const
+{
+	pthread_mutex_lock(&m_lock);
+	double rate = m_rates[key % KEYS];
+	pthread_mutex_unlock(&m_lock);
+
+	return rate;
+}
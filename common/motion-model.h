@@ -0,0 +1,58 @@
+
+#ifndef __MOTION_MODEL_H
+#define __MOTION_MODEL_H
+
+#include <pthread.h>
+
+// Dead reckoning between position samples.  The step rate is learned
+// per speed setting from consecutive samples of a move, so the estimate
+// needs no bus traffic and corrects itself on every real sample.
+//
+// Sample is meant for the thread that talks to the device; Estimate may
+// be called from any thread.
+class CMotionModel
+{
+public:
+    typedef struct _motion_estimate {
+        // Interpolated position, clamped to the target
+        unsigned int position;
+        unsigned int target;
+        // Time until the focuser should reach the target
+        unsigned int etaMs;
+        // Learned rate for the current speed, steps per second
+        double rate;
+    } MOTION_ESTIMATE;
+
+    CMotionModel();
+    ~CMotionModel();
+
+    // key picks the calibration: the speed setting the move runs at
+    void Sample(unsigned long long us, unsigned int position, unsigned int target, bool moving, unsigned int key);
+
+    // Forget the current move but keep the learned rates
+    void Stop();
+
+    // False while not moving or before the rate for the current speed
+    // has been learned
+    bool Estimate(unsigned long long us, MOTION_ESTIMATE &estimate) const;
+
+    double Rate(unsigned int key) const;
+
+private:
+    enum { KEYS = 256 };
+
+    mutable pthread_mutex_t m_lock;
+    double m_rates[KEYS];
+
+    // Where the current rate measurement started
+    unsigned long long m_anchorUs;
+    unsigned int m_anchorPosition;
+
+    bool m_moving;
+    unsigned long long m_lastUs;
+    unsigned int m_lastPosition;
+    unsigned int m_target;
+    unsigned int m_key;
+};
+
+#endif
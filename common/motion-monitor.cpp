@@ -0,0 +1,127 @@
+#include "motion-monitor.h"
+
+CMotionMonitor::CMotionMonitor(int wrongSamples, int stallSamples, unsigned int stallMs, int resends)
+{
+	m_wrongSamples = wrongSamples;
+	m_stallSamples = stallSamples;
+	m_stallUs = stallMs * 1000ULL;
+	m_resendLimit = resends;
+
+	Reset();
+}
+
+void CMotionMonitor::Reset()
+{
+	m_valid = false;
+	m_lastUs = 0;
+	m_lastDistance = 0;
+	m_target = 0;
+
+	m_goodUs = 0;
+	m_wrong = 0;
+	m_stalled = 0;
+	m_resends = 0;
+
+	m_velocity = 0;
+	m_lastStall = false;
+
+	m_stats.wrongDirection = 0;
+	m_stats.stalls = 0;
+	m_stats.resends = 0;
+	m_stats.aborts = 0;
+	m_stats.latency.Reset();
+}
+
+int CMotionMonitor::Sample(unsigned long long us, unsigned int position, unsigned int target, bool moving)
+{
+	unsigned int distance = position > target ? position - target : target - position;
+
+	// A new target starts afresh, with its own resend allowance
+	if (target != m_target)
+	{
+		m_resends = 0;
+	}
+
+	if (!moving || !m_valid || target != m_target)
+	{
+		m_valid = moving;
+		m_lastUs = us;
+		m_lastDistance = distance;
+		m_target = target;
+		m_goodUs = us;
+		m_wrong = 0;
+		m_stalled = 0;
+		m_velocity = 0;
+
+		return NONE;
+	}
+
+	unsigned long long dt = us > m_lastUs ? us - m_lastUs : 0;
+	long progress = (long)m_lastDistance - (long)distance;
+
+	if (dt > 0)
+	{
+		m_velocity = progress * 1000000.0 / dt;
+	}
+
+	m_lastUs = us;
+	m_lastDistance = distance;
+
+	if (progress > 0)
+	{
+		m_goodUs = us;
+		m_wrong = 0;
+		m_stalled = 0;
+		return NONE;
+	}
+
+	if (progress < 0)
+	{
+		m_stalled = 0;
+		if (++m_wrong >= m_wrongSamples)
+		{
+			return Detected(us, false);
+		}
+
+		return NONE;
+	}
+
+	m_wrong = 0;
+	if (++m_stalled >= m_stallSamples && us - m_goodUs >= m_stallUs)
+	{
+		return Detected(us, true);
+	}
+
+	return NONE;
+}
+
+int CMotionMonitor::Detected(unsigned long long us, bool stall)
+{
+	if (stall)
+	{
+		m_stats.stalls++;
+	}
+	else
+	{
+		m_stats.wrongDirection++;
+	}
+
+	m_stats.latency.Record(us - m_goodUs);
+	m_lastStall = stall;
+
+	// Whatever happens next is a fresh start for the detector
+	m_goodUs = us;
+	m_wrong = 0;
+	m_stalled = 0;
+
+	if (m_resends < m_resendLimit)
+	{
+		m_resends++;
+		m_stats.resends++;
+		return RESEND;
+	}
+
+	m_stats.aborts++;
+	m_valid = false;
+	return ABORT;
+}
@@ -0,0 +1,68 @@
+
+#ifndef __MOTION_MONITOR_H
+#define __MOTION_MONITOR_H
+
+#include "latency-histogram.h"
+
+// Watches timestamped position samples of a commanded move for a motor
+// running away from its target or not moving at all.  A fault needs a
+// few consecutive bad samples, so one late or stale read is not enough.
+// Each detection asks for a resend of the move, up to a bound per
+// target, then for an abort.
+//
+// Not thread safe; feed and read it from one thread.
+class CMotionMonitor
+{
+public:
+    enum { NONE, RESEND, ABORT };
+
+    typedef struct _monitor_stats {
+        unsigned long wrongDirection;
+        unsigned long stalls;
+        unsigned long resends;
+        unsigned long aborts;
+        // From the last good sample to the detection, in us
+        CLatencyHistogram latency;
+    } MONITOR_STATS;
+
+    CMotionMonitor(int wrongSamples = 2, int stallSamples = 3, unsigned int stallMs = 500, int resends = 2);
+
+    // Returns the action the sample calls for
+    int Sample(unsigned long long us, unsigned int position, unsigned int target, bool moving);
+
+    // Steps per second towards the target over the last two samples;
+    // negative while moving away
+    double Velocity() const { return m_velocity; }
+
+    // What the last non-NONE action was for
+    bool LastWasStall() const { return m_lastStall; }
+
+    const MONITOR_STATS &Stats() const { return m_stats; }
+    void Reset();
+
+private:
+    int m_wrongSamples;
+    int m_stallSamples;
+    unsigned long long m_stallUs;
+    int m_resendLimit;
+
+    bool m_valid;
+    unsigned long long m_lastUs;
+    unsigned int m_lastDistance;
+    unsigned int m_target;
+
+    // Last sample that made progress, and the bad ones since
+    unsigned long long m_goodUs;
+    int m_wrong;
+    int m_stalled;
+    int m_resends;
+
+    double m_velocity;
+    bool m_lastStall;
+
+    MONITOR_STATS m_stats;
+
+    int Detected(unsigned long long us, bool stall);
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "move-coalescer.h"
+
+CMoveCoalescer::CMoveCoalescer() : m_pending(NONE)
+{
+	ResetCounts();
+}
+
+void CMoveCoalescer::ResetCounts()
+{
+	m_offered = 0;
+	m_coalesced = 0;
+	m_sent = 0;
+	m_cancelled = 0;
+}
+
+bool CMoveCoalescer::Offer(unsigned int target)
+{
+	m_offered++;
+
+	if (m_pending.exchange(target) != NONE)
+	{
+		m_coalesced++;
+		return false;
+	}
+
+	return true;
+}
+
+bool CMoveCoalescer::Take(unsigned int &target)
+{
+	long pending = m_pending.exchange(NONE);
+	if (pending == NONE)
+	{
+		return false;
+	}
+
+	target = pending;
+	m_sent++;
+
+	return true;
+}
+
+void CMoveCoalescer::Cancel()
+{
+	if (m_pending.exchange(NONE) != NONE)
+	{
+		m_cancelled++;
+	}
+}
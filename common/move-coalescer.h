@@ -0,0 +1,48 @@
+
+#ifndef __MOVE_COALESCER_H
+#define __MOVE_COALESCER_H
+
+#include <atomic>
+
+// Holds at most one unsent absolute move target.  A newer target
+// replaces an older one that has not gone to the bus yet, so a burst of
+// moves from a slider drag or a script costs one bus write per round
+// trip instead of one per request.
+//
+// Offer may be called from one thread and Take from another.
+class CMoveCoalescer
+{
+public:
+    CMoveCoalescer();
+
+    // True when nothing was pending, in which case the caller has to
+    // arrange for a Take.  False means an unsent target was replaced and
+    // the Take already due will carry this one instead.
+    bool Offer(unsigned int target);
+
+    // Claims the latest target for sending
+    bool Take(unsigned int &target);
+
+    // Drops any unsent target, e.g. because of an abort
+    void Cancel();
+
+    bool Pending() const { return m_pending.load() != NONE; }
+
+    void ResetCounts();
+    unsigned long Offered() const { return m_offered; }
+    unsigned long Coalesced() const { return m_coalesced; }
+    unsigned long Sent() const { return m_sent; }
+    unsigned long Cancelled() const { return m_cancelled; }
+
+private:
+    static const long NONE = -1;
+
+    std::atomic<long> m_pending;
+
+    std::atomic<unsigned long> m_offered;
+    std::atomic<unsigned long> m_coalesced;
+    std::atomic<unsigned long> m_sent;
+    std::atomic<unsigned long> m_cancelled;
+};
+
+#endif
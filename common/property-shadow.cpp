@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "property-shadow.h"
+
+CPropertyShadow::CPropertyShadow()
+{
+	m_emitted = 0;
+	m_suppressed = 0;
+}
+
+CPropertyShadow::SHADOW &CPropertyShadow::Lookup(const void *property, const char *name, IPState s, size_t nvalues, bool &changed)
+{
+	SHADOW &shadow = m_shadows[property];
+
+	changed = !shadow.valid || shadow.s != s || shadow.values.size() != nvalues;
+
+	shadow.name = name;
+	shadow.valid = true;
+	shadow.s = s;
+	shadow.values.resize(nvalues);
+
+	return shadow;
+}
+
+void CPropertyShadow::Update(SHADOW &shadow, size_t i, double value, bool &changed)
+{
+	if (shadow.values[i] != value)
+	{
+		shadow.values[i] = value;
+		changed = true;
+	}
+}
+
+bool CPropertyShadow::Count(bool changed)
+{
+	if (changed)
+	{
+		m_emitted++;
+	}
+	else
+	{
+		m_suppressed++;
+	}
+
+	return changed;
+}
+
+bool CPropertyShadow::SetNumber(INumberVectorProperty *nvp)
+{
+	bool changed;
+	SHADOW &shadow = Lookup(nvp, nvp->name, nvp->s, nvp->nnp * 3, changed);
+
+	// Limits are part of what the client sees, so track them too
+	for (int i = 0; i < nvp->nnp; i++)
+	{
+		Update(shadow, i * 3, nvp->np[i].value, changed);
+		Update(shadow, i * 3 + 1, nvp->np[i].min, changed);
+		Update(shadow, i * 3 + 2, nvp->np[i].max, changed);
+	}
+
+	if (!Count(changed))
+	{
+		return false;
+	}
+
+	IDSetNumber(nvp, NULL);
+	return true;
+}
+
+bool CPropertyShadow::SetSwitch(ISwitchVectorProperty *svp)
+{
+	bool changed;
+	SHADOW &shadow = Lookup(svp, svp->name, svp->s, svp->nsp, changed);
+
+	for (int i = 0; i < svp->nsp; i++)
+	{
+		Update(shadow, i, svp->sp[i].s, changed);
+	}
+
+	if (!Count(changed))
+	{
+		return false;
+	}
+
+	IDSetSwitch(svp, NULL);
+	return true;
+}
+
+void CPropertyShadow::Invalidate(const char *name)
+{
+	std::map<const void *, SHADOW>::iterator it;
+
+	for (it = m_shadows.begin(); it != m_shadows.end(); ++it)
+	{
+		if (it->second.valid && strcmp(it->second.name, name) == 0)
+		{
+			it->second.valid = false;
+		}
+	}
+}
+
+void CPropertyShadow::Reset()
+{
+	std::map<const void *, SHADOW>::iterator it;
+
+	for (it = m_shadows.begin(); it != m_shadows.end(); ++it)
+	{
+		it->second.valid = false;
+	}
+}
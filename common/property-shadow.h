@@ -0,0 +1,49 @@
+
+#ifndef __PROPERTY_SHADOW_H
+#define __PROPERTY_SHADOW_H
+
+#include <map>
+#include <vector>
+
+#include "indidevapi.h"
+
+// Keeps a copy of the last value and state sent to clients for each
+// property and only emits a property when one of them has changed.
+class CPropertyShadow
+{
+public:
+    CPropertyShadow();
+
+    // Return true if the property was sent, false if it was suppressed.
+    bool SetNumber(INumberVectorProperty *nvp);
+    bool SetSwitch(ISwitchVectorProperty *svp);
+
+    // Forget what was sent, e.g. after a property was set outside the
+    // shadow or when a new connection starts.
+    void Invalidate(const char *name);
+    void Reset();
+
+    unsigned long Emitted() const { return m_emitted; }
+    unsigned long Suppressed() const { return m_suppressed; }
+
+private:
+    typedef struct _shadow {
+        const char *name;
+        bool valid;
+        IPState s;
+        std::vector<double> values;
+    } SHADOW;
+
+    // Keyed by the property itself so the poll path never allocates
+    // once every property has been sent once.
+    std::map<const void *, SHADOW> m_shadows;
+
+    unsigned long m_emitted;
+    unsigned long m_suppressed;
+
+    SHADOW &Lookup(const void *property, const char *name, IPState s, size_t nvalues, bool &changed);
+    void Update(SHADOW &shadow, size_t i, double value, bool &changed);
+    bool Count(bool changed);
+};
+
+#endif
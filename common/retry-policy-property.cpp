@@ -0,0 +1,69 @@
+#include "retry-policy-property.h"
+
+CRetryPolicyProperty::CRetryPolicyProperty()
+{
+	m_state = -1;
+	m_attempts = 0;
+	m_rejected = 0;
+}
+
+void CRetryPolicyProperty::Fill(const char *dev, const char *group)
+{
+	IUFillNumber(&m_n[ATTEMPTS], "ATTEMPTS", "Attempts", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[RETRIES], "RETRIES", "Retries", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[TRIPS], "TRIPS", "Breaker trips", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[PROBES], "PROBES", "Probes", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[REJECTED], "REJECTED", "Rejected", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[RECOVERIES], "RECOVERIES", "Recoveries", "%.f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[RECOVERY_MEAN_MS], "RECOVERY_MEAN_MS", "Recovery mean (ms)", "%.1f", 0., 0., 0., 0.);
+	IUFillNumber(&m_n[RECOVERY_MAX_MS], "RECOVERY_MAX_MS", "Recovery max (ms)", "%.1f", 0., 0., 0., 0.);
+	IUFillNumberVector(&m_nvp, m_n, ELEMENTS, dev, "BUS_HEALTH", "Bus Health", group, IP_RO, 0, IPS_IDLE);
+
+	m_state = -1;
+	m_attempts = 0;
+	m_rejected = 0;
+}
+
+void CRetryPolicyProperty::Define(INDI::DefaultDevice *device)
+{
+	device->defineNumber(&m_nvp);
+}
+
+void CRetryPolicyProperty::Delete(INDI::DefaultDevice *device)
+{
+	device->deleteProperty(m_nvp.name);
+}
+
+void CRetryPolicyProperty::Publish(const CRetryPolicy &policy, bool stateOnly)
+{
+	CRetryPolicy::RETRY_STATS stats;
+	policy.GetStats(stats);
+
+	bool changed = stats.state != m_state;
+	if (!changed && (stateOnly || (stats.attempts == m_attempts && stats.rejected == m_rejected)))
+	{
+		return;
+	}
+
+	m_state = stats.state;
+	m_attempts = stats.attempts;
+	m_rejected = stats.rejected;
+
+	m_n[ATTEMPTS].value = stats.attempts;
+	m_n[RETRIES].value = stats.retries;
+	m_n[TRIPS].value = stats.trips;
+	m_n[PROBES].value = stats.probes;
+	m_n[REJECTED].value = stats.rejected;
+	m_n[RECOVERIES].value = stats.recovery.Count();
+	m_n[RECOVERY_MEAN_MS].value = stats.recovery.Mean() / 1000.;
+	m_n[RECOVERY_MAX_MS].value = stats.recovery.Max() / 1000.;
+
+	switch (stats.state)
+	{
+		case CRetryPolicy::OPEN:		m_nvp.s = IPS_ALERT; break;
+		case CRetryPolicy::HALF_OPEN:	m_nvp.s = IPS_BUSY; break;
+		default:						m_nvp.s = IPS_OK; break;
+	}
+
+	IDSetNumber(&m_nvp, NULL);
+}
@@ -0,0 +1,36 @@
+
+#ifndef __RETRY_POLICY_PROPERTY_H
+#define __RETRY_POLICY_PROPERTY_H
+
+#include "defaultdevice.h"
+#include "retry-policy.h"
+
+// Publishes a CRetryPolicy's breaker state and recovery times as one
+// read-only number vector.  The vector is in alert while the breaker is
+// open and busy while it is probing.
+class CRetryPolicyProperty
+{
+public:
+    CRetryPolicyProperty();
+
+    void Fill(const char *dev, const char *group);
+
+    void Define(INDI::DefaultDevice *device);
+    void Delete(INDI::DefaultDevice *device);
+
+    // Send the vector if anything changed since the last call.  With
+    // stateOnly, only a breaker state change is worth sending.
+    void Publish(const CRetryPolicy &policy, bool stateOnly = false);
+
+private:
+    enum { ATTEMPTS, RETRIES, TRIPS, PROBES, REJECTED, RECOVERIES, RECOVERY_MEAN_MS, RECOVERY_MAX_MS, ELEMENTS };
+
+    INumber m_n[ELEMENTS];
+    INumberVectorProperty m_nvp;
+
+    int m_state;
+    unsigned long m_attempts;
+    unsigned long m_rejected;
+};
+
+#endif
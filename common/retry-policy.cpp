@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "retry-policy.h"
+#include "monotonic-clock.h"
+
+CRetryPolicy::CRetryPolicy(int attempts, unsigned int baseUs, unsigned int maxUs, int tripAfter, unsigned int probeMs)
+{
+	m_attempts = attempts;
+	m_baseUs = baseUs;
+	m_maxUs = maxUs;
+	m_tripAfter = tripAfter;
+	m_probeMs = probeMs;
+
+	m_seed = (unsigned int)MonotonicUs() ^ (unsigned int)(unsigned long)this;
+
+	m_preempted = false;
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	pthread_mutex_init(&m_lock, NULL);
+	Reset();
+}
+
+CRetryPolicy::~CRetryPolicy()
+{
+	pthread_mutex_destroy(&m_lock);
+
+	if (m_wakeFd >= 0)
+	{
+		close(m_wakeFd);
+	}
+}
+
+void CRetryPolicy::Preempt()
+{
+	m_preempted = true;
+
+	uint64_t one = 1;
+	if (m_wakeFd >= 0 && write(m_wakeFd, &one, sizeof(one)) != sizeof(one))
+	{
+		// Already signalled
+	}
+}
+
+void CRetryPolicy::ClearPreempt()
+{
+	m_preempted = false;
+
+	uint64_t count;
+	if (m_wakeFd >= 0 && read(m_wakeFd, &count, sizeof(count)) != sizeof(count))
+	{
+		// Nothing was pending
+	}
+}
+
+void CRetryPolicy::Reset()
+{
+	pthread_mutex_lock(&m_lock);
+
+	m_state = CLOSED;
+	m_failures = 0;
+	m_openedMs = 0;
+	m_outageUs = 0;
+
+	m_stats.state = CLOSED;
+	m_stats.attempts = 0;
+	m_stats.retries = 0;
+	m_stats.trips = 0;
+	m_stats.probes = 0;
+	m_stats.rejected = 0;
+	m_stats.recovery.Reset();
+
+	pthread_mutex_unlock(&m_lock);
+}
+
+int CRetryPolicy::State() const
+{
+	pthread_mutex_lock(&m_lock);
+	int state = m_state;
+	pthread_mutex_unlock(&m_lock);
+
+	return state;
+}
+
+void CRetryPolicy::GetStats(RETRY_STATS &stats) const
+{
+	pthread_mutex_lock(&m_lock);
+	stats = m_stats;
+	stats.state = m_state;
+	pthread_mutex_unlock(&m_lock);
+}
+
+// While open, only one probe per period reaches the bus; urgent
+// operations always do.
+bool CRetryPolicy::Allow(bool urgent)
+{
+	pthread_mutex_lock(&m_lock);
+
+	bool allow = true;
+	if (m_state == OPEN && !urgent)
+	{
+		if (MonotonicMs() - m_openedMs >= m_probeMs)
+		{
+			m_state = HALF_OPEN;
+			m_stats.probes++;
+		}
+		else
+		{
+			m_stats.rejected++;
+			allow = false;
+		}
+	}
+
+	pthread_mutex_unlock(&m_lock);
+
+	return allow;
+}
+
+void CRetryPolicy::Result(bool ok, bool retry)
+{
+	pthread_mutex_lock(&m_lock);
+
+	m_stats.attempts++;
+	if (retry)
+	{
+		m_stats.retries++;
+	}
+
+	if (ok)
+	{
+		if (m_outageUs != 0)
+		{
+			m_stats.recovery.Record(MonotonicUs() - m_outageUs);
+			m_outageUs = 0;
+		}
+
+		m_state = CLOSED;
+		m_failures = 0;
+	}
+	else
+	{
+		if (m_outageUs == 0)
+		{
+			m_outageUs = MonotonicUs();
+		}
+
+		// A failed probe reopens the breaker straight away
+		if (m_state == HALF_OPEN || ++m_failures >= m_tripAfter)
+		{
+			if (m_state == CLOSED)
+			{
+				m_stats.trips++;
+			}
+
+			m_state = OPEN;
+			m_openedMs = MonotonicMs();
+		}
+	}
+
+	pthread_mutex_unlock(&m_lock);
+}
+
+// Equal jitter: half the exponential step is fixed and half random, so
+// retries from several callers spread out but never come back too soon.
+void CRetryPolicy::Backoff(int failures)
+{
+	unsigned long long step = m_baseUs;
+	for (int i = 1; i < failures && step < m_maxUs; i++)
+	{
+		step *= 2;
+	}
+
+	if (step > m_maxUs)
+	{
+		step = m_maxUs;
+	}
+
+	unsigned long long us = step / 2 + rand_r(&m_seed) % (step / 2 + 1);
+
+	struct timespec delay;
+	delay.tv_sec = us / 1000000;
+	delay.tv_nsec = (us % 1000000) * 1000;
+
+	if (m_wakeFd < 0)
+	{
+		while (nanosleep(&delay, &delay) != 0)
+		{
+			// Interrupted; sleep for what is left
+		}
+
+		return;
+	}
+
+	// Sleep on the wake fd so that Preempt ends the wait at once
+	struct pollfd pfd;
+	pfd.fd = m_wakeFd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	ppoll(&pfd, 1, &delay, NULL);
+}
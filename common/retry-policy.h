@@ -0,0 +1,114 @@
+
+#ifndef __RETRY_POLICY_H
+#define __RETRY_POLICY_H
+
+#include <pthread.h>
+#include <atomic>
+
+#include "latency-histogram.h"
+
+// Retries a bus operation with jittered exponential backoff, behind a
+// circuit breaker.  Once enough attempts in a row have failed the
+// breaker opens and operations fail at once instead of hammering a dead
+// bus; every probe period one attempt is let through to test it again.
+// The time from the first failure of an outage to the next success is
+// recorded as the recovery time.
+//
+// Run is meant for the one thread that owns the bus; GetStats and
+// Preempt may be called from any thread.
+class CRetryPolicy
+{
+public:
+    enum { CLOSED, OPEN, HALF_OPEN };
+
+    typedef struct _retry_stats {
+        int state;
+        unsigned long attempts;
+        unsigned long retries;
+        unsigned long trips;
+        unsigned long probes;
+        unsigned long rejected;
+        // Recovery times in microseconds
+        CLatencyHistogram recovery;
+    } RETRY_STATS;
+
+    CRetryPolicy(int attempts = 3, unsigned int baseUs = 2000, unsigned int maxUs = 50000,
+                 int tripAfter = 6, unsigned int probeMs = 2000);
+    ~CRetryPolicy();
+
+    // Calls op until it returns true or the attempts run out, sleeping
+    // between attempts.  Returns the number of attempts made, zero if
+    // the breaker refused to try at all or a preemption was pending.
+    // An urgent operation is tried even while the breaker is open and
+    // is not cut short by Preempt.
+    template <typename OP>
+    int Run(OP op, bool &ok, bool urgent = false)
+    {
+        ok = false;
+
+        int attempt;
+        for (attempt = 1; attempt <= m_attempts; attempt++)
+        {
+            if ((!urgent && m_preempted) || !Allow(urgent))
+            {
+                return attempt - 1;
+            }
+
+            if (attempt > 1)
+            {
+                Backoff(attempt - 1);
+
+                if (!urgent && m_preempted)
+                {
+                    return attempt - 1;
+                }
+            }
+
+            ok = op();
+            Result(ok, attempt > 1);
+
+            if (ok)
+            {
+                break;
+            }
+        }
+
+        return attempt > m_attempts ? m_attempts : attempt;
+    }
+
+    // Stops Run before its next attempt and wakes it from a backoff
+    // sleep, until ClearPreempt.  An attempt already on the bus is left
+    // to finish.
+    void Preempt();
+    void ClearPreempt();
+    bool Preempted() const { return m_preempted; }
+
+    int State() const;
+    void GetStats(RETRY_STATS &stats) const;
+    void Reset();
+
+private:
+    int m_attempts;
+    unsigned int m_baseUs;
+    unsigned int m_maxUs;
+    int m_tripAfter;
+    unsigned int m_probeMs;
+
+    unsigned int m_seed;
+
+    std::atomic<bool> m_preempted;
+    int m_wakeFd;
+
+    mutable pthread_mutex_t m_lock;
+    int m_state;
+    int m_failures;
+    unsigned long long m_openedMs;
+    unsigned long long m_outageUs;
+    RETRY_STATS m_stats;
+
+    bool Allow(bool urgent);
+    void Result(bool ok, bool retry);
+    void Backoff(int failures);
+};
+
+#endif
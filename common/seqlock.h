@@ -0,0 +1,81 @@
+
+#ifndef __SEQLOCK_H
+#define __SEQLOCK_H
+
+#include <atomic>
+#include <string.h>
+
+// Single writer, many reader snapshot of a plain struct.  Readers never
+// block the writer; they retry until they copy the payload without a
+// store overlapping.  The payload is held in atomic words so a reader
+// racing the writer is well defined, just discarded.
+//
+// The sequence is even when stable and advances by two per Store, so
+// readers can compare it with the last one they saw to skip work.
+template <typename T>
+class CSeqLock
+{
+public:
+    CSeqLock() : m_seq(0)
+    {
+        for (int i = 0; i < WORDS; i++)
+        {
+            m_data[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Store(const T &value)
+    {
+        unsigned long words[WORDS];
+        memset(words, 0, sizeof(words));
+        memcpy(words, &value, sizeof(T));
+
+        unsigned long seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (int i = 0; i < WORDS; i++)
+        {
+            m_data[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Copy out a consistent snapshot and return the sequence it was
+    // taken at.  Zero means nothing has been stored yet.
+    unsigned long Load(T &value) const
+    {
+        unsigned long words[WORDS];
+        unsigned long before, after;
+
+        do
+        {
+            before = m_seq.load(std::memory_order_acquire);
+
+            for (int i = 0; i < WORDS; i++)
+            {
+                words[i] = m_data[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        memcpy(&value, words, sizeof(T));
+        return before;
+    }
+
+    unsigned long Sequence() const
+    {
+        return m_seq.load(std::memory_order_acquire) & ~1UL;
+    }
+
+private:
+    enum { WORDS = (sizeof(T) + sizeof(unsigned long) - 1) / sizeof(unsigned long) };
+
+    std::atomic<unsigned long> m_seq;
+    std::atomic<unsigned long> m_data[WORDS];
+};
+
+#endif
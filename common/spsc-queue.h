@@ -0,0 +1,59 @@
+#ifndef __SPSC_QUEUE_H
+#define __SPSC_QUEUE_H
+
+#include <atomic>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread.  Neither side ever blocks or allocates; Push fails
+// when the queue is full.  N must be a power of two.
+template <typename T, unsigned int N>
+class CSpscQueue
+{
+public:
+    CSpscQueue() : m_head(0), m_tail(0) {}
+
+    // Producer side
+    bool Push(const T &item)
+    {
+        unsigned long tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == N)
+        {
+            return false;
+        }
+
+        m_items[tail & (N - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer side
+    bool Pop(T &item)
+    {
+        unsigned long head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = m_items[head & (N - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+    T m_items[N];
+
+    // Padded onto separate cache lines so the two threads do not share
+    // one.  Padding rather than alignas keeps plain new usable in C++11.
+    char m_pad0[64];
+    std::atomic<unsigned long> m_head;
+    char m_pad1[64 - sizeof(std::atomic<unsigned long>)];
+    std::atomic<unsigned long> m_tail;
+    char m_pad2[64 - sizeof(std::atomic<unsigned long>)];
+};
+
+#endif
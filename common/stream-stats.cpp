@@ -0,0 +1,141 @@
+#include "stream-stats.h"
+
+CStreamStats::CStreamStats(double alpha)
+{
+	m_alpha = alpha;
+	Reset();
+}
+
+void CStreamStats::Reset()
+{
+	for (int i = 0; i < WINDOW; i++)
+	{
+		m_times[i] = 0;
+		m_values[i] = 0;
+	}
+
+	m_head = 0;
+	m_count = 0;
+
+	m_origin = 0;
+	m_sumT = 0;
+	m_sumTT = 0;
+	m_sumX = 0;
+	m_sumXX = 0;
+	m_sumTX = 0;
+	m_sinceRebuild = 0;
+
+	m_ewma = 0;
+	m_last = 0;
+}
+
+void CStreamStats::Add(double seconds, double value)
+{
+	if (m_count == 0)
+	{
+		m_origin = seconds;
+		m_ewma = value;
+	}
+	else
+	{
+		m_ewma += m_alpha * (value - m_ewma);
+	}
+
+	m_last = value;
+
+	double t = seconds - m_origin;
+
+	// Drop the oldest sample once the window is full
+	if (m_count == WINDOW)
+	{
+		double oldT = m_times[m_head];
+		double oldX = m_values[m_head];
+
+		m_sumT -= oldT;
+		m_sumTT -= oldT * oldT;
+		m_sumX -= oldX;
+		m_sumXX -= oldX * oldX;
+		m_sumTX -= oldT * oldX;
+	}
+	else
+	{
+		m_count++;
+	}
+
+	m_times[m_head] = t;
+	m_values[m_head] = value;
+	m_head = (m_head + 1) % WINDOW;
+
+	m_sumT += t;
+	m_sumTT += t * t;
+	m_sumX += value;
+	m_sumXX += value * value;
+	m_sumTX += t * value;
+
+	// Adding and removing leaves rounding behind; start the sums afresh
+	// once a window, moving the origin up to the oldest sample as well.
+	if (++m_sinceRebuild >= WINDOW)
+	{
+		Rebuild();
+	}
+}
+
+void CStreamStats::Rebuild()
+{
+	unsigned int oldest = (m_head + WINDOW - m_count) % WINDOW;
+	double shift = m_times[oldest];
+
+	m_origin += shift;
+	m_sumT = 0;
+	m_sumTT = 0;
+	m_sumX = 0;
+	m_sumXX = 0;
+	m_sumTX = 0;
+
+	for (unsigned int i = 0; i < m_count; i++)
+	{
+		unsigned int index = (oldest + i) % WINDOW;
+		double t = m_times[index] - shift;
+		double x = m_values[index];
+
+		m_times[index] = t;
+
+		m_sumT += t;
+		m_sumTT += t * t;
+		m_sumX += x;
+		m_sumXX += x * x;
+		m_sumTX += t * x;
+	}
+
+	m_sinceRebuild = 0;
+}
+
+void CStreamStats::Get(STREAM_SUMMARY &summary) const
+{
+	summary.count = m_count;
+	summary.last = m_last;
+	summary.ewma = m_ewma;
+	summary.mean = 0;
+	summary.variance = 0;
+	summary.slope = 0;
+
+	if (m_count == 0)
+	{
+		return;
+	}
+
+	double n = m_count;
+	summary.mean = m_sumX / n;
+
+	if (m_count > 1)
+	{
+		double variance = (m_sumXX - m_sumX * m_sumX / n) / (n - 1);
+		summary.variance = variance > 0 ? variance : 0;
+
+		double spread = m_sumTT - m_sumT * m_sumT / n;
+		if (spread > 0)
+		{
+			summary.slope = (m_sumTX - m_sumT * m_sumX / n) / spread;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+
+#ifndef __STREAM_STATS_H
+#define __STREAM_STATS_H
+
+// Running statistics over the most recent samples of a slow signal such
+// as a temperature.  Mean, variance and the least squares slope cover a
+// fixed window held in a ring; the EWMA covers everything seen since the
+// last Reset.  Adding a sample is O(1) and never allocates.
+class CStreamStats
+{
+public:
+    enum { WINDOW = 128 };
+
+    typedef struct _stream_summary {
+        // Samples in the window
+        unsigned int count;
+        double last;
+        double mean;
+        double variance;
+        double ewma;
+        // Units per second over the window, zero until it spans time
+        double slope;
+    } STREAM_SUMMARY;
+
+    // alpha weighs each new sample in the EWMA
+    CStreamStats(double alpha = 0.1);
+
+    // Sample times are seconds on any clock that does not go backwards
+    void Add(double seconds, double value);
+    void Reset();
+
+    void Get(STREAM_SUMMARY &summary) const;
+
+private:
+    double m_alpha;
+
+    double m_times[WINDOW];
+    double m_values[WINDOW];
+    unsigned int m_head;
+    unsigned int m_count;
+
+    // Times are kept relative to m_origin so their squares stay precise
+    double m_origin;
+    double m_sumT;
+    double m_sumTT;
+    double m_sumX;
+    double m_sumXX;
+    double m_sumTX;
+    // Samples added since the sums were last rebuilt from the ring
+    unsigned int m_sinceRebuild;
+
+    double m_ewma;
+    double m_last;
+
+    void Rebuild();
+};
+
+#endif
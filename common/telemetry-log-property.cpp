@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "telemetry-log-property.h"
+
+CTelemetryLogProperty::CTelemetryLogProperty()
+{
+	memset(m_t, 0, sizeof(m_t));
+}
+
+void CTelemetryLogProperty::Fill(const char *dev, const char *group)
+{
+	IUFillText(&m_t[0], "FILE", "File (blank = off)", "");
+	IUFillTextVector(&m_tp, m_t, 1, dev, "TELEMETRY_LOG", "Telemetry Log", group, IP_RW, 0, IPS_IDLE);
+}
+
+void CTelemetryLogProperty::Define(INDI::DefaultDevice *device)
+{
+	device->defineText(&m_tp);
+}
+
+void CTelemetryLogProperty::Save(FILE *fp)
+{
+	IUSaveConfigText(fp, &m_tp);
+}
+
+bool CTelemetryLogProperty::ISNewText(const char *name, char *texts[], char *names[], int n, bool connected)
+{
+	if (strcmp(name, m_tp.name) != 0)
+	{
+		return false;
+	}
+
+	IUUpdateText(&m_tp, texts, names, n);
+	m_tp.s = IPS_OK;
+	IDSetText(&m_tp, NULL);
+
+	if (connected)
+	{
+		DEBUGDEVICE(m_tp.device, INDI::Logger::DBG_SESSION, "Telemetry log takes effect on the next connect");
+	}
+
+	return true;
+}
+
+void CTelemetryLogProperty::Open(size_t bytes, const char *const names[], int fields)
+{
+	const char *path = m_t[0].text;
+	if (path == NULL || path[0] == 0)
+	{
+		return;
+	}
+
+	if (!m_log.Open(path, bytes, m_tp.device, names, fields))
+	{
+		DEBUGFDEVICE(m_tp.device, INDI::Logger::DBG_WARNING, "Could not open telemetry log %s", path);
+		return;
+	}
+
+	DEBUGFDEVICE(m_tp.device, INDI::Logger::DBG_SESSION, "Recording telemetry to %s", path);
+}
+
+void CTelemetryLogProperty::Close()
+{
+	if (m_log.IsOpen())
+	{
+		DEBUGFDEVICE(m_tp.device, INDI::Logger::DBG_SESSION, "Telemetry log closed after %lu records", m_log.Records());
+		m_log.Close();
+	}
+}
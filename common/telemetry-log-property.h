@@ -0,0 +1,41 @@
+#ifndef __TELEMETRY_LOG_PROPERTY_H
+#define __TELEMETRY_LOG_PROPERTY_H
+
+#include <stdio.h>
+
+#include "defaultdevice.h"
+#include "telemetry-log.h"
+
+// The client side of a CTelemetryLog.  TELEMETRY_LOG names the file to
+// record to, blank for none; a new name takes effect on the next
+// connect, when the driver opens the log with its own fields.
+class CTelemetryLogProperty
+{
+public:
+    CTelemetryLogProperty();
+
+    void Fill(const char *dev, const char *group);
+
+    void Define(INDI::DefaultDevice *device);
+    void Save(FILE *fp);
+
+    const char *Name() const { return m_tp.name; }
+
+    // True if the name is the log's property
+    bool ISNewText(const char *name, char *texts[], char *names[], int n, bool connected);
+
+    // Start recording to the configured file, if there is one.  A file
+    // that cannot be opened is logged and leaves recording off.
+    void Open(size_t bytes, const char *const names[], int fields);
+    void Close();
+
+    CTelemetryLog &Log() { return m_log; }
+
+private:
+    IText m_t[1];
+    ITextVectorProperty m_tp;
+
+    CTelemetryLog m_log;
+};
+
+#endif
@@ -0,0 +1,465 @@
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+
+#include "telemetry-log.h"
+
+// Longest varint of a 64 bit value
+#define VARINT_MAX		10
+
+static size_t PutVarint(unsigned char *out, uint64_t value)
+{
+	size_t n = 0;
+
+	while (value >= 0x80)
+	{
+		out[n++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = (unsigned char)value;
+
+	return n;
+}
+
+// Zero if the varint runs past end
+static size_t GetVarint(const unsigned char *in, const unsigned char *end, uint64_t &value)
+{
+	size_t n = 0;
+	int shift = 0;
+
+	value = 0;
+	while (in + n < end && shift < 64)
+	{
+		unsigned char byte = in[n++];
+		value |= (uint64_t)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80))
+		{
+			return n;
+		}
+
+		shift += 7;
+	}
+
+	return 0;
+}
+
+// Small changes either way encode in few bytes
+static uint64_t ZigZag(long value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> (sizeof(long) * 8 - 1));
+}
+
+static long UnZigZag(uint64_t value)
+{
+	return (long)(value >> 1) ^ -(long)(value & 1);
+}
+
+static uint64_t ClockUs(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+CTelemetryLog::CTelemetryLog()
+{
+	m_map = NULL;
+	m_size = 0;
+	m_header = NULL;
+	m_fields = 0;
+
+	m_block = 0;
+	m_seq = 0;
+	m_realtimeOffsetUs = 0;
+	m_lastUs = 0;
+	m_records = 0;
+	memset(m_last, 0, sizeof(m_last));
+}
+
+CTelemetryLog::~CTelemetryLog()
+{
+	Close();
+}
+
+bool CTelemetryLog::Open(const char *path, size_t bytes, const char *source, const char *const names[], int fields)
+{
+	Close();
+
+	size_t blocks = bytes / TELEMETRY_BLOCK_SIZE;
+	if (fields < 1 || fields > TELEMETRY_MAX_FIELDS || blocks < 2)
+	{
+		return false;
+	}
+
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	m_size = blocks * TELEMETRY_BLOCK_SIZE;
+
+	// Keep an existing log only if its records can be carried on as is
+	TELEMETRY_HEADER existing;
+	struct stat st;
+	bool resume = fstat(fd, &st) == 0 && (size_t)st.st_size == m_size &&
+		pread(fd, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+		Matches(existing, blocks - 1, names, fields);
+
+	// The first block holds the header; the space is reserved up front
+	// so a full disk shows up here rather than as a fault later.
+	if (!resume && (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, m_size) != 0))
+	{
+		close(fd);
+		return false;
+	}
+
+	void *map = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_map = (unsigned char *)map;
+	m_header = (TELEMETRY_HEADER *)m_map;
+	m_fields = fields;
+
+	uint64_t monotonicUs = ClockUs(CLOCK_MONOTONIC);
+	uint64_t realtimeUs = ClockUs(CLOCK_REALTIME);
+	m_realtimeOffsetUs = (int64_t)(realtimeUs - monotonicUs);
+
+	m_seq = 0;
+	m_records = 0;
+
+	if (resume)
+	{
+		// Carry on after the newest block
+		uint32_t newest = m_header->blocks - 1;
+		for (uint32_t i = 0; i < m_header->blocks; i++)
+		{
+			if (Block(i)->seq > m_seq)
+			{
+				m_seq = Block(i)->seq;
+				newest = i;
+			}
+		}
+
+		m_header->openMonotonicUs = monotonicUs;
+		m_header->openRealtimeUs = realtimeUs;
+
+		StartBlock((newest + 1) % m_header->blocks, monotonicUs);
+		return true;
+	}
+
+	memset(m_header, 0, sizeof(*m_header));
+	m_header->version = TELEMETRY_VERSION;
+	m_header->blockSize = TELEMETRY_BLOCK_SIZE;
+	m_header->blocks = blocks - 1;
+	m_header->fields = fields;
+	m_header->openMonotonicUs = monotonicUs;
+	m_header->openRealtimeUs = realtimeUs;
+	strncpy(m_header->source, source, sizeof(m_header->source) - 1);
+
+	for (int i = 0; i < fields; i++)
+	{
+		strncpy(m_header->names[i], names[i], TELEMETRY_NAME_SIZE - 1);
+	}
+
+	// Readers ignore the file until the magic is in place
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(m_header->magic, TELEMETRY_MAGIC, sizeof(m_header->magic));
+
+	StartBlock(0, monotonicUs);
+
+	return true;
+}
+
+bool CTelemetryLog::Matches(const TELEMETRY_HEADER &header, size_t blocks, const char *const names[], int fields) const
+{
+	if (memcmp(header.magic, TELEMETRY_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != TELEMETRY_VERSION ||
+		header.blockSize != TELEMETRY_BLOCK_SIZE ||
+		header.blocks != blocks ||
+		header.fields != (uint32_t)fields)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < fields; i++)
+	{
+		if (strncmp(header.names[i], names[i], TELEMETRY_NAME_SIZE - 1) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CTelemetryLog::Close()
+{
+	if (m_map == NULL)
+	{
+		return;
+	}
+
+	msync(m_map, m_size, MS_ASYNC);
+	munmap(m_map, m_size);
+
+	m_map = NULL;
+	m_header = NULL;
+	m_size = 0;
+}
+
+TELEMETRY_BLOCK *CTelemetryLog::Block(uint32_t index) const
+{
+	return (TELEMETRY_BLOCK *)(m_map + (size_t)(index + 1) * TELEMETRY_BLOCK_SIZE);
+}
+
+void CTelemetryLog::StartBlock(uint32_t index, unsigned long long us)
+{
+	TELEMETRY_BLOCK *block = Block(index);
+
+	// Invalidate before reuse so the block is never read half old, half new
+	block->seq = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	block->baseUs = us;
+	block->realtimeOffsetUs = m_realtimeOffsetUs;
+	block->used = 0;
+	block->records = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	block->seq = ++m_seq;
+
+	m_block = index;
+	m_lastUs = us;
+	memset(m_last, 0, sizeof(m_last));
+}
+
+size_t CTelemetryLog::Encode(unsigned long long us, const long values[], unsigned char *out) const
+{
+	size_t n = PutVarint(out, us > m_lastUs ? us - m_lastUs : 0);
+
+	for (int i = 0; i < m_fields; i++)
+	{
+		n += PutVarint(out + n, ZigZag(values[i] - m_last[i]));
+	}
+
+	return n;
+}
+
+void CTelemetryLog::Append(unsigned long long us, const long values[])
+{
+	if (m_map == NULL)
+	{
+		return;
+	}
+
+	unsigned char record[VARINT_MAX * (TELEMETRY_MAX_FIELDS + 1)];
+	const size_t space = TELEMETRY_BLOCK_SIZE - sizeof(TELEMETRY_BLOCK);
+
+	TELEMETRY_BLOCK *block = Block(m_block);
+	size_t n = Encode(us, values, record);
+
+	if (block->used + n > space)
+	{
+		// Start afresh in the next block, overwriting the oldest
+		StartBlock((m_block + 1) % m_header->blocks, us);
+		block = Block(m_block);
+		n = Encode(us, values, record);
+	}
+
+	memcpy((unsigned char *)(block + 1) + block->used, record, n);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	block->used += n;
+	block->records++;
+
+	m_lastUs = us;
+	memcpy(m_last, values, m_fields * sizeof(long));
+	m_records++;
+}
+
+CTelemetryReader::CTelemetryReader()
+{
+	m_map = NULL;
+	m_size = 0;
+	m_header = NULL;
+
+	m_next = 0;
+	m_block = NULL;
+	m_offset = 0;
+	m_remaining = 0;
+	m_lastUs = 0;
+	memset(m_last, 0, sizeof(m_last));
+}
+
+CTelemetryReader::~CTelemetryReader()
+{
+	Close();
+}
+
+static bool BlockBefore(const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+{
+	return a.first < b.first;
+}
+
+bool CTelemetryReader::Open(const char *path)
+{
+	Close();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	off_t size = lseek(fd, 0, SEEK_END);
+	if (size < (off_t)(2 * TELEMETRY_BLOCK_SIZE))
+	{
+		close(fd);
+		return false;
+	}
+
+	void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_map = (unsigned char *)map;
+	m_size = size;
+	m_header = (const TELEMETRY_HEADER *)m_map;
+
+	if (memcmp(m_header->magic, TELEMETRY_MAGIC, sizeof(m_header->magic)) != 0 ||
+		m_header->version != TELEMETRY_VERSION ||
+		m_header->blockSize != TELEMETRY_BLOCK_SIZE ||
+		m_header->fields < 1 || m_header->fields > TELEMETRY_MAX_FIELDS ||
+		(size_t)(m_header->blocks + 1) * TELEMETRY_BLOCK_SIZE > m_size)
+	{
+		Close();
+		return false;
+	}
+
+	std::vector<std::pair<uint64_t, uint32_t> > blocks;
+	for (uint32_t i = 0; i < m_header->blocks; i++)
+	{
+		if (Block(i)->seq != 0)
+		{
+			blocks.push_back(std::make_pair(Block(i)->seq, i));
+		}
+	}
+
+	std::sort(blocks.begin(), blocks.end(), BlockBefore);
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		m_order.push_back(blocks[i].second);
+	}
+
+	return true;
+}
+
+void CTelemetryReader::Close()
+{
+	if (m_map != NULL)
+	{
+		munmap(m_map, m_size);
+	}
+
+	m_map = NULL;
+	m_header = NULL;
+	m_size = 0;
+
+	m_order.clear();
+	m_next = 0;
+	m_block = NULL;
+	m_remaining = 0;
+}
+
+const TELEMETRY_BLOCK *CTelemetryReader::Block(uint32_t index) const
+{
+	return (const TELEMETRY_BLOCK *)(m_map + (size_t)(index + 1) * TELEMETRY_BLOCK_SIZE);
+}
+
+long long CTelemetryReader::WallUs(unsigned long long us) const
+{
+	return (long long)us + (m_block != NULL ? m_block->realtimeOffsetUs : 0);
+}
+
+bool CTelemetryReader::Next(unsigned long long &us, long values[])
+{
+	if (m_map == NULL)
+	{
+		return false;
+	}
+
+	while (m_block == NULL || m_remaining == 0)
+	{
+		if (m_next >= m_order.size())
+		{
+			return false;
+		}
+
+		m_block = Block(m_order[m_next++]);
+		m_offset = 0;
+		m_remaining = m_block->records;
+		m_lastUs = m_block->baseUs;
+		memset(m_last, 0, sizeof(m_last));
+	}
+
+	const unsigned char *data = (const unsigned char *)(m_block + 1);
+	uint32_t used = m_block->used;
+	if (used > TELEMETRY_BLOCK_SIZE - sizeof(TELEMETRY_BLOCK))
+	{
+		used = TELEMETRY_BLOCK_SIZE - sizeof(TELEMETRY_BLOCK);
+	}
+
+	const unsigned char *end = data + used;
+	const unsigned char *p = data + m_offset;
+
+	uint64_t value;
+	size_t n = GetVarint(p, end, value);
+	if (n == 0)
+	{
+		// Truncated block; move on to the next
+		m_remaining = 0;
+		return Next(us, values);
+	}
+
+	p += n;
+	m_lastUs += value;
+
+	for (uint32_t i = 0; i < m_header->fields; i++)
+	{
+		n = GetVarint(p, end, value);
+		if (n == 0)
+		{
+			m_remaining = 0;
+			return Next(us, values);
+		}
+
+		p += n;
+		m_last[i] += UnZigZag(value);
+	}
+
+	m_offset = p - data;
+	m_remaining--;
+
+	us = m_lastUs;
+	memcpy(values, m_last, m_header->fields * sizeof(long));
+
+	return true;
+}
@@ -0,0 +1,131 @@
+
+#ifndef __TELEMETRY_LOG_H
+#define __TELEMETRY_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Append-only ring of integer snapshots in a memory mapped file, cheap
+// enough to record every poll or report all night.
+//
+// The ring is a run of fixed size blocks.  Each record is the time since
+// the previous one and the change of every field, as varints; the first
+// record of a block is relative to the block's base time and zero, so
+// any block decodes on its own and the oldest can simply be overwritten.
+// Blocks carry a sequence number that orders them when read back, and
+// the offset from the monotonic to the wall clock of the session that
+// wrote them, so a log kept across restarts and reboots still reads back
+// in wall time.
+//
+// Open and Close belong to one thread; Append to a single writer, which
+// may be another thread as long as it only runs while the log is open.
+// Append neither allocates nor makes a system call.
+
+#define TELEMETRY_MAGIC         "FOCUSTLG"
+#define TELEMETRY_VERSION       2
+#define TELEMETRY_MAX_FIELDS    16
+#define TELEMETRY_NAME_SIZE     16
+#define TELEMETRY_BLOCK_SIZE    4096
+
+typedef struct _telemetry_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint32_t blocks;
+    uint32_t fields;
+    // The same instant on both clocks when the log was last opened
+    uint64_t openMonotonicUs;
+    uint64_t openRealtimeUs;
+    char source[64];
+    char names[TELEMETRY_MAX_FIELDS][TELEMETRY_NAME_SIZE];
+} TELEMETRY_HEADER;
+
+typedef struct _telemetry_block {
+    // Zero while the block is unused or being recycled
+    uint64_t seq;
+    uint64_t baseUs;
+    // Wall clock minus monotonic clock for the records in this block
+    int64_t realtimeOffsetUs;
+    // Bytes of records after this header
+    uint32_t used;
+    uint32_t records;
+} TELEMETRY_BLOCK;
+
+class CTelemetryLog
+{
+public:
+    CTelemetryLog();
+    ~CTelemetryLog();
+
+    // Carries on after the newest block of an existing log with the same
+    // size and fields, so a reconnect keeps what was recorded before;
+    // anything else at path is replaced.  bytes is rounded down to whole
+    // blocks.
+    bool Open(const char *path, size_t bytes, const char *source, const char *const names[], int fields);
+    void Close();
+
+    bool IsOpen() const { return m_map != NULL; }
+
+    // values holds one entry per field
+    void Append(unsigned long long us, const long values[]);
+
+    unsigned long Records() const { return m_records; }
+
+private:
+    unsigned char *m_map;
+    size_t m_size;
+
+    TELEMETRY_HEADER *m_header;
+    int m_fields;
+
+    uint32_t m_block;
+    uint64_t m_seq;
+    int64_t m_realtimeOffsetUs;
+    unsigned long long m_lastUs;
+    long m_last[TELEMETRY_MAX_FIELDS];
+    unsigned long m_records;
+
+    TELEMETRY_BLOCK *Block(uint32_t index) const;
+    void StartBlock(uint32_t index, unsigned long long us);
+    bool Matches(const TELEMETRY_HEADER &header, size_t blocks, const char *const names[], int fields) const;
+    size_t Encode(unsigned long long us, const long values[], unsigned char *out) const;
+};
+
+// Reads a log back in time order.  Meant for logs no longer being
+// written; on a live log it is a best effort look.
+class CTelemetryReader
+{
+public:
+    CTelemetryReader();
+    ~CTelemetryReader();
+
+    bool Open(const char *path);
+    void Close();
+
+    const TELEMETRY_HEADER &Header() const { return *m_header; }
+
+    // False once every record has been read
+    bool Next(unsigned long long &us, long values[]);
+
+    // Wall clock microseconds of a time returned by the last Next
+    long long WallUs(unsigned long long us) const;
+
+private:
+    unsigned char *m_map;
+    size_t m_size;
+    const TELEMETRY_HEADER *m_header;
+
+    // Blocks in sequence order and the read position within them
+    std::vector<uint32_t> m_order;
+    size_t m_next;
+    const TELEMETRY_BLOCK *m_block;
+    size_t m_offset;
+    uint32_t m_remaining;
+    unsigned long long m_lastUs;
+    long m_last[TELEMETRY_MAX_FIELDS];
+
+    const TELEMETRY_BLOCK *Block(uint32_t index) const;
+};
+
+#endif
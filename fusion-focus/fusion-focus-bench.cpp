@@ -0,0 +1,69 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+// Measures how long client requests take to reach the focuser and to be
+// reported complete, using the simulated focuser behind the real driver.
+//
+//   fusion_focus_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "fusion-focus.h"
+#include "fusion-focus-registers.h"
+#include "fusion-simulator.h"
+#include "bench-harness.h"
+
+#define DEFAULT_ITERATIONS 100
+
+extern std::vector<std::unique_ptr<FusionFocus>> fusionDevices;
+
+static void Probe(__u8 command, void *arg)
+{
+    INDI_UNUSED(arg);
+    CBenchProbe::Seen(command);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    FILE *out = BenchOpenOutput();
+
+    CFusionSimulator::SetProbe(Probe, NULL);
+
+    ISGetProperties(NULL);
+
+    FusionFocus *fusion = fusionDevices[0].get();
+    const char *dev = fusion->getDeviceName();
+    BenchSwitch(dev, "SIMULATION", "ENABLE");
+    BenchSwitch(dev, "CONNECTION", "CONNECT");
+
+    BENCH_COMMANDS commands;
+    commands.move = FOCUS_SET_MOVE;
+    commands.sync = FOCUS_SET_POS;
+    commands.abort = FOCUS_SET_STOP;
+    commands.prefs = FOCUS_SET_BACKLASH;
+
+    fprintf(out, "%s, %d iterations\n", dev, iterations);
+    int failed = BenchRun(fusion, commands, iterations, out);
+
+    BenchSwitch(dev, "CONNECTION", "DISCONNECT");
+    fclose(out);
+
+    return failed ? 1 : 0;
+}
@@ -1,30 +1,10 @@
-#include <unistd.h>				//Needed for I2C port
-#include <fcntl.h>				//Needed for I2C port
-#include <sys/ioctl.h>			//Needed for I2C port
-#include <linux/i2c-dev.h>		//Needed for I2C port
 #include <linux/i2c.h>
 #include <errno.h>
 
 #include "fusion-focus-driver.h"
-
-#define ADDRESS 			0x08
-
-#define FOCUS_GET_POS     	0X04
-#define FOCUS_SET_POS     	0x05
-#define FOCUS_GET_MOVE    	0x06
-#define FOCUS_SET_MOVE    	0x07
-#define FOCUS_SET_STOP    	0x08
-#define FOCUS_GET_MAX     	0x09
-#define FOCUS_SET_MAX     	0x0A
-#define FOCUS_GET_MICRON  	0x0B
-#define FOCUS_SET_MICRON  	0x0C
-#define FOCUS_GET_DIR     	0x0D
-#define FOCUS_SET_DIR     	0x0E
-#define FOCUS_GET_SETTINGS 	0x10
-#define FOCUS_GET_BACKLASH  0x11
-#define FOCUS_SET_BACKLASH  0x12
-#define FOCUS_GET_SPEED     0x13
-#define FOCUS_SET_SPEED     0x14
+#include "fusion-focus-registers.h"
+#include "i2c-session.h"
+#include "monotonic-clock.h"
 
 //#define FLIP_BITS(A)	(((A & 0xFF00) >> 8 ) + ((A & 0x00FF) << 8 ))
 #define FLIP_BITS(A)	(A)
@@ -34,147 +14,136 @@ CFusionFocusDriver::CFocusException::CFocusException(int err)
 	m_err = err;
 }
 
-void CFusionFocusDriver::I2CAccess(int file, char read_write, __u8 command, int size, union i2c_smbus_data *data)
+CFusionFocusDriver::CFusionFocusDriver(const char *bus, __u16 address)
 {
-	struct i2c_smbus_ioctl_data args;
-	__s32 err;
+	m_transport = new CI2CSession(bus, address);
+}
 
-	args.read_write = read_write;
-	args.command = command;
-	args.size = size;
-	args.data = data;
+// Takes ownership of the transport
+CFusionFocusDriver::CFusionFocusDriver(CI2CTransport *transport)
+{
+	m_transport = transport;
+}
 
-	err = ioctl(file, I2C_SMBUS, &args);
-	if (err == -1)
-	{
-		throw CFocusException(100);
-	}
+CFusionFocusDriver::~CFusionFocusDriver()
+{
+	m_transport->Close();
+	delete m_transport;
+}
+
+const I2C_STATS &CFusionFocusDriver::GetBusStats()
+{
+	return m_transport->Stats();
+}
 
+void CFusionFocusDriver::SetBusTiming(const I2C_TIMING &timing)
+{
+	m_transport->SetTiming(timing);
+}
+
+const CBusStats &CFusionFocusDriver::GetCommandStats()
+{
+	return m_commandStats;
 }
 
-int CFusionFocusDriver::I2COpen()
+void CFusionFocusDriver::I2CAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data)
 {
-	char *filename = (char*)"/dev/i2c-1";
-	int file_i2c;
+	unsigned long long start = MonotonicUs();
+
+	int err = m_transport->SmbusAccess(read_write, command, size, data);
+	m_commandStats.Record(command, MonotonicUs() - start, err == 0);
 
-	if ((file_i2c = open(filename, O_RDWR)) < 0)
+	if (err != 0)
 	{
-		throw CFocusException(200);
+		throw CFocusException(err);
 	}
+}
 
-    if (ioctl(file_i2c, I2C_SLAVE, ADDRESS) < 0) {
-		throw CFocusException(250);
-	}
+// Transfers are counted under the command they carry, readbacks included
+void CFusionFocusDriver::I2CExecute(__u8 command, CI2CTransaction &trans)
+{
+	unsigned long long start = MonotonicUs();
+
+	int err = trans.Execute(*m_transport);
+	m_commandStats.Record(command, MonotonicUs() - start, err == 0);
 
-	return file_i2c;
+	if (err != 0)
+	{
+		throw CFocusException(err);
+	}
 }
 
 unsigned int CFusionFocusDriver::I2CGetWord(__u8 command)
 {
-	int file = I2COpen();
-	if(file > 0)
-	{
-    	union i2c_smbus_data data;
-		I2CAccess(file, I2C_SMBUS_READ, command, I2C_SMBUS_WORD_DATA, &data);
-		
-		int result =  0xFFFF & data.word;
-    	// Need to swap MSB & LSB
+	union i2c_smbus_data data;
+	I2CAccess(I2C_SMBUS_READ, command, I2C_SMBUS_WORD_DATA, &data);
 
-		close(file);
+	int result =  0xFFFF & data.word;
+	// Need to swap MSB & LSB
 
-		return FLIP_BITS(result);
-	}
-	else
-	{
-		throw CFocusException(350);
-	}
+	return FLIP_BITS(result);
 }
 
-void CFusionFocusDriver::I2CSetWord(__u8 command, __u16 value)
+void CFusionFocusDriver::I2CSetWord(__u8 command, __u16 value, FOCUSER *readback)
 {
-	int file = I2COpen();
-	if(file > 0)
-	{
-		union i2c_smbus_data data;
-		data.word = value;
-		I2CAccess(file, I2C_SMBUS_WRITE, command, I2C_SMBUS_WORD_DATA, &data);
-		close(file);
-	}
-	else
+	if (readback != NULL)
 	{
-		throw CFocusException(360); 
+		CI2CTransaction trans(m_transport->Address());
+		trans.WriteWord(command, value);
+		I2CReadback(command, trans, readback);
+		return;
 	}
+
+	union i2c_smbus_data data;
+	data.word = value;
+	I2CAccess(I2C_SMBUS_WRITE, command, I2C_SMBUS_WORD_DATA, &data);
 }
 
 unsigned int CFusionFocusDriver::I2CGetByte(__u8 command)
 {
-	int file = I2COpen();
-	if(file > 0)
-	{
-    	union i2c_smbus_data data;
+	union i2c_smbus_data data;
 
-		I2CAccess(file, I2C_SMBUS_READ, command, I2C_SMBUS_BYTE_DATA, &data);
-		
-		int result =  0x00FF & data.byte;
-		close(file);
+	I2CAccess(I2C_SMBUS_READ, command, I2C_SMBUS_BYTE_DATA, &data);
 
-		return result;
-	}
-	else
-	{
-		throw CFocusException(370);
-	}
+	int result =  0x00FF & data.byte;
+
+	return result;
 }
 
-void CFusionFocusDriver::I2CSetByte(__u8 command, __u8 value)
+void CFusionFocusDriver::I2CSetByte(__u8 command, __u8 value, FOCUSER *readback)
 {
-	int file = I2COpen();
-	if(file > 0)
-	{
-		union i2c_smbus_data data;
-		data.byte = (__u8)value;
-		I2CAccess(file, I2C_SMBUS_WRITE, command, I2C_SMBUS_BYTE_DATA, &data);
-		close(file);
-	}
-	else
+	if (readback != NULL)
 	{
-		throw CFocusException(380);
+		CI2CTransaction trans(m_transport->Address());
+		trans.WriteByte(command, value);
+		I2CReadback(command, trans, readback);
+		return;
 	}
+
+	union i2c_smbus_data data;
+	data.byte = (__u8)value;
+	I2CAccess(I2C_SMBUS_WRITE, command, I2C_SMBUS_BYTE_DATA, &data);
 }
 
 void CFusionFocusDriver::I2CGetBuffer(__u8 command, __u8* buffer, int buflen)
 {
-	int file = I2COpen();
-	if(file > 0)
-	{
-		struct i2c_msg msgs[2];
-
-		msgs[0].addr = ADDRESS;
-		msgs[0].flags = 0;
-		msgs[0].len = 1;
-		msgs[0].buf = &command;
-		msgs[1].addr = ADDRESS;
-		msgs[1].flags = I2C_M_RD;
-		msgs[1].len = buflen;
-		msgs[1].buf = buffer;
+	CI2CTransaction trans(m_transport->Address());
+	trans.Read(command, buffer, buflen);
 
-		int nmsgs = 2;
+	I2CExecute(command, trans);
+}
 
-		struct i2c_rdwr_ioctl_data rdwr;
-		rdwr.msgs = msgs;
-		rdwr.nmsgs = nmsgs;
+// Append a read of the settings block to a command so the caller gets
+// the confirmed device state back in the same ioctl.  The caller's copy
+// is only touched if the whole transfer succeeded.
+void CFusionFocusDriver::I2CReadback(__u8 command, CI2CTransaction &trans, FOCUSER *readback)
+{
+	FOCUSER settings;
+	trans.Read(FOCUS_GET_SETTINGS, (__u8*)&settings, sizeof(FOCUSER));
 
-		int nmsgs_sent = ioctl(file, I2C_RDWR, &rdwr);
-		if (nmsgs_sent < 0) {
-			throw CFocusException(500);
-		} 
+	I2CExecute(command, trans);
 
-		close(file);
-	}
-	else
-	{
-		throw CFocusException(380);
-	}
+	*readback = settings;
 }
 
 
@@ -183,9 +152,9 @@ unsigned int CFusionFocusDriver::GetPosition()
 	return I2CGetWord(FOCUS_GET_POS);
 }
 
-void CFusionFocusDriver::SetPosition(unsigned int posn)
+void CFusionFocusDriver::SetPosition(unsigned int posn, FOCUSER *readback)
 {
-	I2CSetWord(FOCUS_SET_POS, FLIP_BITS(posn));
+	I2CSetWord(FOCUS_SET_POS, FLIP_BITS(posn), readback);
 }
 
 unsigned int CFusionFocusDriver::GetMove()
@@ -193,9 +162,9 @@ unsigned int CFusionFocusDriver::GetMove()
 	return I2CGetWord(FOCUS_GET_MOVE);
 }
 
-void CFusionFocusDriver::SetMove(unsigned int move)
+void CFusionFocusDriver::SetMove(unsigned int move, FOCUSER *readback)
 {
-	I2CSetWord(FOCUS_SET_MOVE, FLIP_BITS(move));
+	I2CSetWord(FOCUS_SET_MOVE, FLIP_BITS(move), readback);
 }
 
 unsigned int CFusionFocusDriver::GetMax()
@@ -203,9 +172,9 @@ unsigned int CFusionFocusDriver::GetMax()
 	return I2CGetWord(FOCUS_GET_MAX);
 }
 
-void CFusionFocusDriver::SetMax(unsigned int max)
+void CFusionFocusDriver::SetMax(unsigned int max, FOCUSER *readback)
 {
-	I2CSetWord(FOCUS_SET_MAX, FLIP_BITS(max));
+	I2CSetWord(FOCUS_SET_MAX, FLIP_BITS(max), readback);
 }
 
 unsigned int CFusionFocusDriver::GetMicron()
@@ -213,9 +182,9 @@ unsigned int CFusionFocusDriver::GetMicron()
 	return I2CGetWord(FOCUS_GET_MICRON);
 }
 
-void CFusionFocusDriver::SetMicron(unsigned int microns)
+void CFusionFocusDriver::SetMicron(unsigned int microns, FOCUSER *readback)
 {
-	I2CSetWord(FOCUS_SET_MICRON, FLIP_BITS(microns));
+	I2CSetWord(FOCUS_SET_MICRON, FLIP_BITS(microns), readback);
 }
 
 unsigned int CFusionFocusDriver::GetBacklash()
@@ -223,9 +192,9 @@ unsigned int CFusionFocusDriver::GetBacklash()
 	return I2CGetWord(FOCUS_GET_BACKLASH);
 }
 
-void CFusionFocusDriver::SetBacklash(unsigned int backlash)
+void CFusionFocusDriver::SetBacklash(unsigned int backlash, FOCUSER *readback)
 {
-	I2CSetWord(FOCUS_SET_BACKLASH, FLIP_BITS(backlash));
+	I2CSetWord(FOCUS_SET_BACKLASH, FLIP_BITS(backlash), readback);
 }
 
 unsigned int CFusionFocusDriver::GetDir()
@@ -233,9 +202,9 @@ unsigned int CFusionFocusDriver::GetDir()
 	return I2CGetByte(FOCUS_GET_DIR);
 }
 
-void CFusionFocusDriver::SetDir(unsigned int dir)
+void CFusionFocusDriver::SetDir(unsigned int dir, FOCUSER *readback)
 {
-	I2CSetByte(FOCUS_SET_DIR, dir);
+	I2CSetByte(FOCUS_SET_DIR, dir, readback);
 }
 
 unsigned char CFusionFocusDriver::GetSpeed()
@@ -243,9 +212,9 @@ unsigned char CFusionFocusDriver::GetSpeed()
 	return I2CGetByte(FOCUS_GET_SPEED);;
 }
 
-void CFusionFocusDriver::SetSpeed(unsigned char speed)
+void CFusionFocusDriver::SetSpeed(unsigned char speed, FOCUSER *readback)
 {
-	I2CSetByte(FOCUS_SET_SPEED, speed);
+	I2CSetByte(FOCUS_SET_SPEED, speed, readback);
 }
 
 void CFusionFocusDriver::GetSettings(FOCUSER *focus_settings)
@@ -253,7 +222,7 @@ void CFusionFocusDriver::GetSettings(FOCUSER *focus_settings)
 	I2CGetBuffer(FOCUS_GET_SETTINGS, (__u8*)focus_settings, sizeof(FOCUSER) );
 }
 
-void CFusionFocusDriver::Abort()
+void CFusionFocusDriver::Abort(FOCUSER *readback)
 {
-	I2CSetByte(FOCUS_SET_STOP, 0x00);
+	I2CSetByte(FOCUS_SET_STOP, 0x00, readback);
 }
@@ -1,6 +1,12 @@
 
+#include <stddef.h>
 #include <i2c/smbus.h>
 
+#include "i2c-transport.h"
+#include "bus-stats.h"
+
+class CI2CTransaction;
+
 
 #ifndef __FUSION_FOCUS_DRIVER_H
 #define __FUSION_FOCUS_DRIVER_H
@@ -24,22 +30,34 @@ typedef struct __attribute__((packed, aligned(2))) _focuser {
 class CFusionFocusDriver
 {
 public:
+    CFusionFocusDriver(const char *bus, __u16 address);
+    CFusionFocusDriver(CI2CTransport *transport);
+    ~CFusionFocusDriver();
+
+    // Setters take an optional readback buffer.  When given, the command
+    // and a read of the settings block are sent as a single transfer.
     unsigned int GetPosition();
-    void SetPosition(unsigned int posn);
+    void SetPosition(unsigned int posn, FOCUSER *readback = NULL);
     unsigned int GetMove();
-    void SetMove(unsigned int move);
+    void SetMove(unsigned int move, FOCUSER *readback = NULL);
     unsigned int GetMax();
-    void SetMax(unsigned int max);
+    void SetMax(unsigned int max, FOCUSER *readback = NULL);
     unsigned int GetBacklash();
-    void SetBacklash(unsigned int max);
+    void SetBacklash(unsigned int max, FOCUSER *readback = NULL);
     unsigned int GetMicron();
-    void SetMicron(unsigned int micron);
+    void SetMicron(unsigned int micron, FOCUSER *readback = NULL);
     unsigned int GetDir();
-    void SetDir(unsigned int dir);
+    void SetDir(unsigned int dir, FOCUSER *readback = NULL);
     void GetSettings(FOCUSER *focus_settings);
-    void Abort();
+    void Abort(FOCUSER *readback = NULL);
     unsigned char GetSpeed();
-    void SetSpeed(unsigned char speed);
+    void SetSpeed(unsigned char speed, FOCUSER *readback = NULL);
+
+    const I2C_STATS &GetBusStats();
+    // Adapter timeout, retries and watchdog deadline; safe from any thread
+    void SetBusTiming(const I2C_TIMING &timing);
+    // Per command count, retries, failures and latency
+    const CBusStats &GetCommandStats();
 
     class CFocusException
     {
@@ -52,14 +70,18 @@ protected:
 
 
 private:
-    void I2CAccess(int file, char read_write, __u8 command, int size, union i2c_smbus_data *data);
-    int I2COpen();
+    CI2CTransport *m_transport;
+    CBusStats m_commandStats;
+
+    void I2CAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data);
 
     unsigned int I2CGetWord(__u8 command);
-    void I2CSetWord(__u8 command, __u16 value);
+    void I2CSetWord(__u8 command, __u16 value, FOCUSER *readback);
     unsigned int I2CGetByte(__u8 command);
-    void I2CSetByte(__u8 command, __u8 value);
+    void I2CSetByte(__u8 command, __u8 value, FOCUSER *readback);
     void I2CGetBuffer(__u8 command, __u8* buffer, int buflen);
+    void I2CExecute(__u8 command, CI2CTransaction &trans);
+    void I2CReadback(__u8 command, CI2CTransaction &trans, FOCUSER *readback);
 };
 
 
@@ -0,0 +1,23 @@
+
+#ifndef __FUSION_FOCUS_REGISTERS_H
+#define __FUSION_FOCUS_REGISTERS_H
+
+// Command bytes understood by the Fusion firmware
+#define FOCUS_GET_POS     	0X04
+#define FOCUS_SET_POS     	0x05
+#define FOCUS_GET_MOVE    	0x06
+#define FOCUS_SET_MOVE    	0x07
+#define FOCUS_SET_STOP    	0x08
+#define FOCUS_GET_MAX     	0x09
+#define FOCUS_SET_MAX     	0x0A
+#define FOCUS_GET_MICRON  	0x0B
+#define FOCUS_SET_MICRON  	0x0C
+#define FOCUS_GET_DIR     	0x0D
+#define FOCUS_SET_DIR     	0x0E
+#define FOCUS_GET_SETTINGS 	0x10
+#define FOCUS_GET_BACKLASH  0x11
+#define FOCUS_SET_BACKLASH  0x12
+#define FOCUS_GET_SPEED     0x13
+#define FOCUS_SET_SPEED     0x14
+
+#endif
@@ -15,36 +15,124 @@
 
 */
 
+#include <math.h>
 #include <unistd.h>
 #include <memory>
+#include <vector>
 #include <cstring>
 
 #include "fusion-focus.h"
+#include "fusion-focus-registers.h"
+#include "fusion-simulator.h"
+#include "monotonic-clock.h"
 
 #define POLL_MS  1000
 #define MAX_STR 255
 #define BUF_SIZE 64
 
-std::unique_ptr<FusionFocus> fusion(new FusionFocus());
+#define STATS_TAB "Statistics"
+#define STATS_PERIOD_MS 10000
+// Alert when an abort takes longer than this to reach the bus
+#define ABORT_ALARM_MS 50
+
+#define TELEMETRY_TAB "Telemetry"
+#define ADC_PERIOD_MS 1000
+
+#define SWEEP_TAB "Sweep"
+
+#define DEFAULT_I2C_BUS "/dev/i2c-1"
+#define DEFAULT_I2C_ADDRESS 0x08
+#define MAX_DEVICES 8
+#define TELEMETRY_LOG_BYTES (16 * 1024 * 1024)
+
+// One device per board.  INDI_FUSION_FOCUSERS sets how many this
+// process hosts; each picks its own bus and address.
+std::vector<std::unique_ptr<FusionFocus>> fusionDevices;
+
+// Commands whose bus traffic is published on the statistics tab
+static const BUS_OPCODE busOpcodes[] = {
+    { FOCUS_GET_SETTINGS, "GET_SETTINGS", "Get Settings" },
+    { FOCUS_SET_MOVE, "SET_MOVE", "Move" },
+    { FOCUS_SET_STOP, "SET_STOP", "Stop" },
+    { FOCUS_SET_POS, "SET_POS", "Sync" },
+    { FOCUS_SET_MAX, "SET_MAX", "Set Max" },
+    { FOCUS_SET_BACKLASH, "SET_BACKLASH", "Set Backlash" },
+    { FOCUS_SET_DIR, "SET_DIR", "Set Direction" },
+    { FOCUS_SET_SPEED, "SET_SPEED", "Set Speed" },
+    { 0, NULL, NULL }
+};
+
+static void CreateDevices()
+{
+    if(!fusionDevices.empty()){
+        return;
+    }
+
+    const char *env = getenv("INDI_FUSION_FOCUSERS");
+    int count = env != NULL ? atoi(env) : 1;
+    if(count < 1){
+        count = 1;
+    } else if(count > MAX_DEVICES){
+        count = MAX_DEVICES;
+    }
+
+    for(int i = 0; i < count; i++){
+        FusionFocus *focus = new FusionFocus();
+
+        // The first keeps the default name so existing configs still apply
+        if(i > 0){
+            char name[MAXINDINAME];
+            snprintf(name, sizeof(name), "%s %d", focus->getDefaultName(), i + 1);
+            focus->setDeviceName(name);
+        }
+
+        fusionDevices.push_back(std::unique_ptr<FusionFocus>(focus));
+    }
+}
+
+static bool IsDevice(const char *dev, FusionFocus *focus)
+{
+    return dev == NULL || !strcmp(dev, focus->getDeviceName());
+}
 
 void ISGetProperties(const char *dev)
 {
-    fusion->ISGetProperties(dev);
+    CreateDevices();
+    for(size_t i = 0; i < fusionDevices.size(); i++){
+        if(IsDevice(dev, fusionDevices[i].get())){
+            fusionDevices[i]->ISGetProperties(dev);
+        }
+    }
 }
 
 void ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int num)
 {
-    fusion->ISNewSwitch(dev, name, states, names, num);
+    CreateDevices();
+    for(size_t i = 0; i < fusionDevices.size(); i++){
+        if(IsDevice(dev, fusionDevices[i].get())){
+            fusionDevices[i]->ISNewSwitch(dev, name, states, names, num);
+        }
+    }
 }
 
 void ISNewText(	const char *dev, const char *name, char *texts[], char *names[], int num)
 {
-    fusion->ISNewText(dev, name, texts, names, num);
+    CreateDevices();
+    for(size_t i = 0; i < fusionDevices.size(); i++){
+        if(IsDevice(dev, fusionDevices[i].get())){
+            fusionDevices[i]->ISNewText(dev, name, texts, names, num);
+        }
+    }
 }
 
 void ISNewNumber(const char *dev, const char *name, double values[], char *names[], int num)
 {
-    fusion->ISNewNumber(dev, name, values, names, num);
+    CreateDevices();
+    for(size_t i = 0; i < fusionDevices.size(); i++){
+        if(IsDevice(dev, fusionDevices[i].get())){
+            fusionDevices[i]->ISNewNumber(dev, name, values, names, num);
+        }
+    }
 }
 
 void ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[], char *names[], int n)
@@ -61,7 +149,10 @@ void ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[],
 
 void ISSnoopDevice (XMLEle *root)
 {
-    fusion->ISSnoopDevice(root);
+    CreateDevices();
+    for(size_t i = 0; i < fusionDevices.size(); i++){
+        fusionDevices[i]->ISSnoopDevice(root);
+    }
 }
 
 FusionFocus::FusionFocus()
@@ -70,12 +161,26 @@ FusionFocus::FusionFocus()
     setSupportedConnections(CONNECTION_NONE);
 
     // Can move in Absolute & Relative motions, can AbortFocuser motion, and has variable speed
-    INDI::Focuser::SetCapability(FOCUSER_CAN_ABS_MOVE | FOCUSER_CAN_ABORT | FOCUSER_CAN_REVERSE|
+    INDI::Focuser::SetCapability(FOCUSER_CAN_ABS_MOVE | FOCUSER_CAN_REL_MOVE | FOCUSER_CAN_ABORT | FOCUSER_CAN_REVERSE|
                                  FOCUSER_CAN_SYNC | FOCUSER_HAS_VARIABLE_SPEED | FOCUSER_HAS_BACKLASH );
 
-    timerid = -1;
+    lastStatsMs = 0;
 
     focusDriver = NULL;
+    worker = NULL;
+    resultCallback = -1;
+    busState = CRetryPolicy::CLOSED;
+    memset(&watchdogLast, 0, sizeof(watchdogLast));
+
+    adcValid = false;
+    adcDatacount = 0;
+    lastAdcMs = 0;
+    temperatureDefined = false;
+
+    sweepTimer = -1;
+
+    requestedPosition = 0;
+    setPosition = -1;
 }
 
 FusionFocus::~FusionFocus()
@@ -87,31 +192,34 @@ bool FusionFocus::ISNewSwitch (const char *dev, const char *name, ISState *state
 {
     if(strcmp(dev,getDeviceName())==0)
     {
+        // The client is about to be sent this property directly
+        propertyShadow.Invalidate(name);
 
         if (!strcmp (name, FocusReverseSP.name)) {
-            FocusReverseSP.s = IPS_OK;
             IUUpdateSwitch(&FocusReverseSP, states, names, n);
             int dir = 0;
             if(FocusReverseS[0].s == ISS_ON){
                 dir = 1;
             }
 
-            UpdateDirection(dir);
+            FocusReverseSP.s = UpdateDirection(dir) ? IPS_BUSY : IPS_ALERT;
             IDSetSwitch(&FocusReverseSP, nullptr);
 
             return true;
         }
 
         if (!strcmp (name, FocusAbortSP.name)) {
-            FocusAbortSP.s = IPS_OK;
-
             IUUpdateSwitch(&FocusAbortSP, states, names, n);
-            AbortFocuser();
+            FocusAbortSP.s = AbortFocuser() ? IPS_BUSY : IPS_ALERT;
             IDSetSwitch(&FocusAbortSP, nullptr);
 
             return true;
         }
 
+        if (sweepProperty.ISNewSwitch(name, states, names, n)) {
+            return true;
+        }
+
        if (strcmp(name, "FOCUS_BACKLASH_TOGGLE") == 0)
         {
             FocusBacklashSP.s = IPS_OK;
@@ -135,48 +243,125 @@ bool FusionFocus::ISNewNumber (const char *dev, const char *name, double values[
 {
     if(strcmp(dev,getDeviceName())==0)
     {
+        // The client is about to be sent this property directly
+        propertyShadow.Invalidate(name);
+        // Bus commands complete on the worker thread; the property stays
+        // busy until the result comes back in HandleResult.
         if (!strcmp (name, FocusMaxPosNP.name)) {
             IUUpdateNumber(&FocusMaxPosNP, values, names, n);
-            FocusMaxPosNP.s = IPS_OK;
+            FocusMaxPosNP.s = UpdateMaxTravel(values[0]) ? IPS_BUSY : IPS_ALERT;
             IDSetNumber(&FocusMaxPosNP, NULL);
 
-            // Update the max travel required
-            return UpdateMaxTravel(values[0]);
+            return FocusMaxPosNP.s == IPS_BUSY;
         }
 
        if (!strcmp (name, FocusSyncNP.name)) {
             IUUpdateNumber(&FocusSyncNP, values, names, n);
-            FocusSyncNP.s = IPS_OK;
+            FocusSyncNP.s = UpdateCurPos(FocusSyncN[0].value) ? IPS_BUSY : IPS_ALERT;
             IDSetNumber(&FocusSyncNP, NULL);
 
-            return UpdateCurPos(FocusSyncN[0].value);
+            return FocusSyncNP.s == IPS_BUSY;
         }
 
         if (!strcmp (name, FocusAbsPosNP.name)) {
+            if (sweep.Active()) {
+                DEBUG(INDI::Logger::DBG_WARNING, "Sweep cancelled by a move");
+                EndSweep(IPS_ALERT);
+            }
+
             IUUpdateNumber(&FocusAbsPosNP, values, names, n);
-            FocusAbsPosNP.s = IPS_BUSY;
+            FocusAbsPosNP.s = MoveFocuser(values[0]) ? IPS_BUSY : IPS_ALERT;
             IDSetNumber(&FocusAbsPosNP, NULL);
 
-            // Update the max travel required
-            return MoveFocuser(values[0]);
+            return FocusAbsPosNP.s == IPS_BUSY;
+        }
+
+        // Handled here rather than by INDI::Focuser, which never sees
+        // the properties of this device.
+        if (!strcmp (name, FocusRelPosNP.name)) {
+            if (sweep.Active()) {
+                DEBUG(INDI::Logger::DBG_WARNING, "Sweep cancelled by a move");
+                EndSweep(IPS_ALERT);
+            }
+
+            IUUpdateNumber(&FocusRelPosNP, values, names, n);
+            FocusDirection dir = FocusMotionS[0].s == ISS_ON ? FOCUS_INWARD : FOCUS_OUTWARD;
+            FocusRelPosNP.s = MoveRelFocuser(dir, FocusRelPosN[0].value);
+            IDSetNumber(&FocusRelPosNP, NULL);
+
+            return FocusRelPosNP.s == IPS_BUSY;
         }
 
 
         if (!strcmp (name, FocusBacklashNP.name)) {
             IUUpdateNumber(&FocusBacklashNP, values, names, n);
-            FocusBacklashNP.s = IPS_OK;
+            FocusBacklashNP.s = UpdateBacklash(values[0]) ? IPS_BUSY : IPS_ALERT;
             IDSetNumber(&FocusBacklashNP, NULL);
 
-            // Update the max travel required
-            return UpdateBacklash(values[0]);
+            return FocusBacklashNP.s == IPS_BUSY;
         }
 
        if (!strcmp (name, FocusSpeedNP.name)) {
             IUUpdateNumber(&FocusSpeedNP, values, names, n);
-            FocusSpeedNP.s = IPS_OK;
+            FocusSpeedNP.s = UpdateSpeed(FocusSpeedN[0].value) ? IPS_BUSY : IPS_ALERT;
             IDSetNumber(&FocusSpeedNP, NULL);
 
-            return UpdateSpeed(FocusSpeedN[0].value);
+            return FocusSpeedNP.s == IPS_BUSY;
+        }
+
+        if (!strcmp (name, PollRatesNP.name)) {
+            IUUpdateNumber(&PollRatesNP, values, names, n);
+            PollRatesNP.s = IPS_OK;
+            IDSetNumber(&PollRatesNP, NULL);
+
+            ApplyPollRates();
+            return true;
+        }
+
+        if (sweepProperty.ISNewNumber(name, values, names, n)) {
+            return true;
+        }
+
+        if (!strcmp (name, TemperatureCalNP.name)) {
+            IUUpdateNumber(&TemperatureCalNP, values, names, n);
+            TemperatureCalNP.s = IPS_OK;
+            IDSetNumber(&TemperatureCalNP, NULL);
+
+            DefineTemperature();
+            PublishAdc();
+            return true;
+        }
+
+        if (!strcmp (name, I2CAddressNP.name)) {
+            if (IUUpdateNumber(&I2CAddressNP, values, names, n) < 0) {
+                I2CAddressNP.s = IPS_ALERT;
+                IDSetNumber(&I2CAddressNP, NULL);
+                return false;
+            }
+
+            I2CAddressNP.s = IPS_OK;
+            IDSetNumber(&I2CAddressNP, NULL);
+
+            if (isConnected()) {
+                DEBUG(INDI::Logger::DBG_SESSION, "I2C address takes effect on the next connect");
+            }
+
+            return true;
+        }
+
+        // Timing applies to the open session straight away
+        if (!strcmp (name, I2CTimingNP.name)) {
+            if (IUUpdateNumber(&I2CTimingNP, values, names, n) < 0) {
+                I2CTimingNP.s = IPS_ALERT;
+                IDSetNumber(&I2CTimingNP, NULL);
+                return false;
+            }
+
+            I2CTimingNP.s = IPS_OK;
+            IDSetNumber(&I2CTimingNP, NULL);
+
+            ApplyBusTiming();
+            return true;
         }
 
         return true;
@@ -196,10 +381,65 @@ bool FusionFocus::Connect(){
         focusDriver = NULL;
     }
 
-    focusDriver = new CFusionFocusDriver();
-    focusDriver->GetSettings(&focusSettings);
+    if(isSimulation())
+    {
+        DEBUG(INDI::Logger::DBG_SESSION, "Using simulated Fusion firmware");
+        focusDriver = new CFusionFocusDriver(new CFusionSimulator());
+    }
+    else
+    {
+        DEBUGF(INDI::Logger::DBG_SESSION, "Using %s address 0x%02X", I2CBusT[0].text, (unsigned int)I2CAddressN[0].value);
+        focusDriver = new CFusionFocusDriver(I2CBusT[0].text, (__u16)I2CAddressN[0].value);
+        ApplyBusTiming();
+    }
+
+    try {
+        focusDriver->GetSettings(&focusSettings);
+    } catch (CFusionFocusDriver::CFocusException e) {
+        DEBUGF(INDI::Logger::DBG_ERROR, "Initial settings read failed with error %d", e.m_err);
+        delete focusDriver;
+        focusDriver = NULL;
+        return false;
+    }
+
+    propertyShadow.Reset();
+
+    setPosition = -1;
+    motionMonitor.Reset();
+    abortLatencyProperty.Reset();
+
+    memset(&watchdogLast, 0, sizeof(watchdogLast));
+    for(int i = 0; i < 4; i++){
+        WatchdogN[i].value = 0;
+    }
+    WatchdogNP.s = IPS_IDLE;
+
+    adcStats[0].Reset();
+    adcStats[1].Reset();
+    adcValid = false;
+    lastAdcMs = 0;
+    UpdateAdc();
 
-    timerid = SetTimer(POLL_MS);
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Initial settings read used %u syscalls", focusDriver->GetBusStats().lastSyscalls);
+
+    telemetryProperty.Open(TELEMETRY_LOG_BYTES, fusionTelemetryFields, FUSION_TELEMETRY_FIELDS);
+
+    // From here on only the worker thread touches the bus
+    worker = new CFusionWorker(focusDriver, &telemetryProperty.Log());
+    ApplyPollRates();
+
+    if(!worker->Start(focusSettings)){
+        DEBUG(INDI::Logger::DBG_ERROR, "Could not start the I2C worker thread");
+        delete worker;
+        worker = NULL;
+        telemetryProperty.Close();
+        delete focusDriver;
+        focusDriver = NULL;
+        return false;
+    }
+
+    busState = CRetryPolicy::CLOSED;
+    resultCallback = IEAddCallback(worker->ResultFd(), ResultsReady, this);
 
     DEBUG(INDI::Logger::DBG_SESSION, "Fusion Focuser has connected");
 
@@ -208,13 +448,32 @@ bool FusionFocus::Connect(){
 
 bool FusionFocus::Disconnect(){
 
-    if(timerid != -1){
-        RemoveTimer(timerid);
-        timerid = -1;
+    if(sweep.Active()){
+        EndSweep(IPS_IDLE);
+    }
+
+    estimateProperty.Stop();
+
+    if(resultCallback != -1){
+        IERmCallback(resultCallback);
+        resultCallback = -1;
+    }
+
+    if(worker != NULL)
+    {
+        worker->Stop();
+        delete worker;
+        worker = NULL;
     }
 
+    telemetryProperty.Close();
+
     if(focusDriver != NULL)
     {
+        const I2C_STATS &stats = focusDriver->GetBusStats();
+        DEBUGF(INDI::Logger::DBG_DEBUG, "I2C session: %lu transactions, %lu syscalls, %lu opens, %lu errors",
+               stats.transactions, stats.syscalls, stats.opens, stats.errors);
+
         delete focusDriver;
         focusDriver = NULL;
     }
@@ -234,6 +493,83 @@ bool FusionFocus::initProperties()
 
     setDefaultPollingPeriod(POLL_MS);
 
+    addSimulationControl();
+
+    IUFillNumber(&PollRatesN[0], "FAST_MS", "Moving (ms)", "%.f", 20., 1000., 10., 100.);
+    IUFillNumber(&PollRatesN[1], "SETTLE_MS", "Settle window (ms)", "%.f", 0., 10000., 100., 2000.);
+    IUFillNumber(&PollRatesN[2], "IDLE_MIN_MS", "Idle min (ms)", "%.f", 100., 10000., 100., 1000.);
+    IUFillNumber(&PollRatesN[3], "IDLE_MAX_MS", "Idle max (ms)", "%.f", 100., 60000., 1000., 8000.);
+    IUFillNumberVector(&PollRatesNP, PollRatesN, 4, getDeviceName(), "POLL_RATES", "Poll Rates", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    IUFillNumber(&PollIntervalN[0], "INTERVAL_MS", "Interval (ms)", "%.f", 0., 60000., 0., 0.);
+    IUFillNumberVector(&PollIntervalNP, PollIntervalN, 1, getDeviceName(), "POLL_INTERVAL", "Poll Interval", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    IUFillNumber(&PublishStatsN[0], "EMITTED", "Emitted", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&PublishStatsN[1], "SUPPRESSED", "Suppressed", "%.f", 0., 0., 0., 0.);
+    IUFillNumberVector(&PublishStatsNP, PublishStatsN, 2, getDeviceName(), "PUBLISH_STATS", "Updates", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    IUFillNumber(&MoveStatsN[0], "REQUESTED", "Requested", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MoveStatsN[1], "SENT", "Sent", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MoveStatsN[2], "COALESCED", "Coalesced", "%.f", 0., 0., 0., 0.);
+    IUFillNumberVector(&MoveStatsNP, MoveStatsN, 3, getDeviceName(), "MOVE_STATS", "Moves", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    IUFillNumber(&MonitorStatsN[0], "WRONG_DIRECTION", "Wrong direction", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MonitorStatsN[1], "STALLS", "Stalls", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MonitorStatsN[2], "RESENDS", "Resends", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MonitorStatsN[3], "ABORTS", "Aborts", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MonitorStatsN[4], "DETECT_MEAN_MS", "Detection mean (ms)", "%.1f", 0., 0., 0., 0.);
+    IUFillNumber(&MonitorStatsN[5], "DETECT_MAX_MS", "Detection max (ms)", "%.1f", 0., 0., 0., 0.);
+    IUFillNumberVector(&MonitorStatsNP, MonitorStatsN, 6, getDeviceName(), "MOTION_MONITOR", "Motion Monitor", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    estimateProperty.Fill(getDeviceName(), MAIN_CONTROL_TAB, propertyShadow, MotionState, this);
+
+    busStatsProperty.Fill(getDeviceName(), STATS_TAB, busOpcodes);
+    busHealthProperty.Fill(getDeviceName(), STATS_TAB);
+    abortLatencyProperty.Fill(getDeviceName(), STATS_TAB, ABORT_ALARM_MS);
+
+    for(int i = 0; i < 2; i++){
+        char name[MAXINDINAME], label[MAXINDILABEL];
+
+        IUFillNumber(&AdcStatsN[i][0], "LAST", "Last", "%.f", 0., 65535., 0., 0.);
+        IUFillNumber(&AdcStatsN[i][1], "MEAN", "Mean", "%.2f", 0., 65535., 0., 0.);
+        IUFillNumber(&AdcStatsN[i][2], "STDDEV", "Std. dev.", "%.2f", 0., 65535., 0., 0.);
+        IUFillNumber(&AdcStatsN[i][3], "EWMA", "EWMA", "%.2f", 0., 65535., 0., 0.);
+        IUFillNumber(&AdcStatsN[i][4], "SLOPE", "Slope (/h)", "%.2f", -65535., 65535., 0., 0.);
+
+        snprintf(name, sizeof(name), "ADC%d_STATS", i + 1);
+        snprintf(label, sizeof(label), "ADC %d", i + 1);
+        IUFillNumberVector(&AdcStatsNP[i], AdcStatsN[i], 5, getDeviceName(), name, label, TELEMETRY_TAB, IP_RO, 0, IPS_IDLE);
+    }
+
+    sweepProperty.Fill(getDeviceName(), SWEEP_TAB);
+
+    IUFillNumber(&TemperatureCalN[0], "CHANNEL", "ADC channel", "%.f", 1., 2., 1., 1.);
+    IUFillNumber(&TemperatureCalN[1], "GAIN", "Gain (C/count)", "%.5f", -100., 100., 0., 0.);
+    IUFillNumber(&TemperatureCalN[2], "OFFSET", "Offset (C)", "%.2f", -1000., 1000., 0., 0.);
+    IUFillNumberVector(&TemperatureCalNP, TemperatureCalN, 3, getDeviceName(), "TEMPERATURE_CALIBRATION", "Temperature", TELEMETRY_TAB, IP_RW, 0, IPS_IDLE);
+
+    IUFillNumber(&TemperatureN[0], "TEMPERATURE", "Celsius", "%6.2f", -50., 70., 0., 0.);
+    IUFillNumberVector(&TemperatureNP, TemperatureN, 1, getDeviceName(), "FOCUS_TEMPERATURE", "Temperature", MAIN_CONTROL_TAB, IP_RO, 0, IPS_IDLE);
+
+    IUFillText(&I2CBusT[0], "DEVICE", "Device", DEFAULT_I2C_BUS);
+    IUFillTextVector(&I2CBusTP, I2CBusT, 1, getDeviceName(), "I2C_BUS", "I2C Bus", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    IUFillNumber(&I2CAddressN[0], "ADDRESS", "Address (decimal)", "%.f", 0x03, 0x77, 1., DEFAULT_I2C_ADDRESS);
+    IUFillNumberVector(&I2CAddressNP, I2CAddressN, 1, getDeviceName(), "I2C_ADDRESS", "I2C Address", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    IUFillNumber(&I2CTimingN[0], "I2C_TIMEOUT", "Adapter timeout (ms)", "%.f", 10., 5000., 10., 100.);
+    IUFillNumber(&I2CTimingN[1], "I2C_RETRIES", "Adapter retries", "%.f", 0., 10., 1., 1.);
+    IUFillNumber(&I2CTimingN[2], "DEADLINE_MS", "Watchdog (ms, 0 = off)", "%.f", 0., 10000., 10., 250.);
+    IUFillNumberVector(&I2CTimingNP, I2CTimingN, 3, getDeviceName(), "I2C_TIMING", "I2C Timing", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    IUFillNumber(&WatchdogN[0], "OVERRUNS", "Overruns", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&WatchdogN[1], "RECOVERIES", "Recoveries", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&WatchdogN[2], "FAILED_RECOVERIES", "Failed recoveries", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&WatchdogN[3], "MAX_MS", "Slowest (ms)", "%.1f", 0., 0., 0., 0.);
+    IUFillNumberVector(&WatchdogNP, WatchdogN, 4, getDeviceName(), "I2C_WATCHDOG", "I2C Watchdog", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    telemetryProperty.Fill(getDeviceName(), OPTIONS_TAB);
+
     DEBUG(INDI::Logger::DBG_DEBUG, "Fusion Focuser initProperties called");
 
     return true;
@@ -247,14 +583,267 @@ bool FusionFocus::updateProperties()
 
     if (isConnected())
     {
+        estimateProperty.Define(this);
+        defineNumber(&PollRatesNP);
+        defineNumber(&PollIntervalNP);
+        defineNumber(&PublishStatsNP);
+        defineNumber(&MoveStatsNP);
+        defineNumber(&MonitorStatsNP);
+        defineNumber(&WatchdogNP);
+        defineNumber(&AdcStatsNP[0]);
+        defineNumber(&AdcStatsNP[1]);
+        defineNumber(&TemperatureCalNP);
+        sweepProperty.Define(this);
+        busStatsProperty.Define(this);
+        busHealthProperty.Define(this);
+        abortLatencyProperty.Define(this);
+
+        loadConfig(true, PollRatesNP.name);
+        loadConfig(true, TemperatureCalNP.name);
+        loadConfig(true, "SWEEP_SETTINGS");
+        loadConfig(true, "SWEEP_APPROACH");
+
+        DefineTemperature();
     }
     else
     {
+        estimateProperty.Delete(this);
+        deleteProperty(PollRatesNP.name);
+        deleteProperty(PollIntervalNP.name);
+        deleteProperty(PublishStatsNP.name);
+        deleteProperty(MoveStatsNP.name);
+        deleteProperty(MonitorStatsNP.name);
+        deleteProperty(WatchdogNP.name);
+        deleteProperty(AdcStatsNP[0].name);
+        deleteProperty(AdcStatsNP[1].name);
+        deleteProperty(TemperatureCalNP.name);
+        sweepProperty.Delete(this);
+        busStatsProperty.Delete(this);
+        busHealthProperty.Delete(this);
+        abortLatencyProperty.Delete(this);
+
+        DefineTemperature();
     }
 
     return true;
 }
 
+// The bus and address are picked before connecting, so they are
+// available while disconnected.
+void FusionFocus::ISGetProperties(const char *dev)
+{
+    INDI::Focuser::ISGetProperties(dev);
+
+    defineText(&I2CBusTP);
+    defineNumber(&I2CAddressNP);
+    defineNumber(&I2CTimingNP);
+    telemetryProperty.Define(this);
+
+    loadConfig(true, I2CBusTP.name);
+    loadConfig(true, I2CAddressNP.name);
+    loadConfig(true, I2CTimingNP.name);
+    loadConfig(true, telemetryProperty.Name());
+}
+
+bool FusionFocus::ISNewText (const char *dev, const char *name, char *texts[], char *names[], int n)
+{
+    if(strcmp(dev,getDeviceName())==0)
+    {
+        if (!strcmp (name, I2CBusTP.name)) {
+            IUUpdateText(&I2CBusTP, texts, names, n);
+            I2CBusTP.s = IPS_OK;
+            IDSetText(&I2CBusTP, NULL);
+
+            if (isConnected()) {
+                DEBUG(INDI::Logger::DBG_SESSION, "I2C bus takes effect on the next connect");
+            }
+
+            return true;
+        }
+
+        // New positions replace a sweep still running.  It ends here,
+        // whether or not the new list can be planned.
+        if (sweep.Active() && !strcmp (name, sweepProperty.PositionsName())) {
+            EndSweep(IPS_ALERT);
+        }
+
+        bool started;
+        if (sweepProperty.ISNewText(name, texts, names, n, sweep, focusSettings.cur_pos, focusSettings.max_move, started)) {
+            if (started) {
+                SweepStep();
+            }
+
+            return true;
+        }
+
+        if (telemetryProperty.ISNewText(name, texts, names, n, isConnected())) {
+            return true;
+        }
+    }
+
+    return INDI::Focuser::ISNewText(dev, name, texts, names, n);
+}
+
+bool FusionFocus::saveConfigItems(FILE *fp)
+{
+    INDI::Focuser::saveConfigItems(fp);
+
+    IUSaveConfigText(fp, &I2CBusTP);
+    IUSaveConfigNumber(fp, &I2CAddressNP);
+    IUSaveConfigNumber(fp, &I2CTimingNP);
+    telemetryProperty.Save(fp);
+
+    IUSaveConfigNumber(fp, &PollRatesNP);
+    IUSaveConfigNumber(fp, &TemperatureCalNP);
+    sweepProperty.Save(fp);
+
+    return true;
+}
+
+// Every settings read carries the ADC averages, but the firmware only
+// renews them when datacount moves on; repeats would weigh the window
+// towards whenever the focuser happened to be polled fast.
+void FusionFocus::UpdateAdc()
+{
+    if(adcValid && focusSettings.datacount == adcDatacount){
+        return;
+    }
+
+    double seconds = MonotonicUs() / 1000000.;
+    adcStats[0].Add(seconds, focusSettings.adc1_mean);
+    adcStats[1].Add(seconds, focusSettings.adc2_mean);
+
+    adcValid = true;
+    adcDatacount = focusSettings.datacount;
+
+    unsigned long long now = MonotonicMs();
+    if(now - lastAdcMs >= ADC_PERIOD_MS){
+        lastAdcMs = now;
+        PublishAdc();
+    }
+}
+
+void FusionFocus::PublishAdc()
+{
+    if(!adcValid || !isConnected()){
+        return;
+    }
+
+    CStreamStats::STREAM_SUMMARY summary;
+
+    for(int i = 0; i < 2; i++){
+        adcStats[i].Get(summary);
+
+        AdcStatsN[i][0].value = summary.last;
+        AdcStatsN[i][1].value = summary.mean;
+        AdcStatsN[i][2].value = sqrt(summary.variance);
+        AdcStatsN[i][3].value = summary.ewma;
+        AdcStatsN[i][4].value = summary.slope * 3600.;
+        AdcStatsNP[i].s = IPS_OK;
+        propertyShadow.SetNumber(&AdcStatsNP[i]);
+    }
+
+    if(temperatureDefined){
+        int channel = TemperatureCalN[0].value >= 2 ? 1 : 0;
+        adcStats[channel].Get(summary);
+
+        // The EWMA rides out single noisy averages
+        TemperatureN[0].value = TemperatureCalN[1].value * summary.ewma + TemperatureCalN[2].value;
+        TemperatureNP.s = IPS_OK;
+        propertyShadow.SetNumber(&TemperatureNP);
+    }
+}
+
+// FOCUS_TEMPERATURE drives temperature compensation in clients, so it
+// only exists while connected and calibrated.
+void FusionFocus::DefineTemperature()
+{
+    bool wanted = isConnected() && TemperatureCalN[1].value != 0;
+
+    if(wanted && !temperatureDefined){
+        propertyShadow.Invalidate(TemperatureNP.name);
+        defineNumber(&TemperatureNP);
+    } else if(!wanted && temperatureDefined){
+        deleteProperty(TemperatureNP.name);
+    }
+
+    temperatureDefined = wanted;
+}
+
+// The poll scheduler lives on the worker thread, so new rates are
+// queued like any other command.
+void FusionFocus::ApplyPollRates()
+{
+    if(worker == NULL){
+        return;
+    }
+
+    FUSION_COMMAND command;
+    memset(&command, 0, sizeof(command));
+    command.op = FUSION_POLL_RATES;
+    for(int i = 0; i < 4; i++){
+        command.rates[i] = PollRatesN[i].value;
+    }
+
+    if(!worker->Submit(command)){
+        DEBUG(INDI::Logger::DBG_ERROR, "I2C command queue full, poll rates not applied");
+    }
+}
+
+bool FusionFocus::Submit(int op, unsigned int value)
+{
+    if(worker == NULL){
+        DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
+        return false;
+    }
+
+    FUSION_COMMAND command;
+    memset(&command, 0, sizeof(command));
+    command.op = op;
+    command.value = value;
+
+    if(!worker->Submit(command)){
+        DEBUG(INDI::Logger::DBG_ERROR, "I2C command queue full, command dropped");
+        return false;
+    }
+
+    return true;
+}
+
+// The counters change on every tick, so they bypass the shadow and are
+// sent on a slow fixed period instead.
+void FusionFocus::PublishStats()
+{
+    unsigned long long now = MonotonicMs();
+    if(now - lastStatsMs < STATS_PERIOD_MS){
+        return;
+    }
+
+    lastStatsMs = now;
+
+    PublishStatsN[0].value = propertyShadow.Emitted();
+    PublishStatsN[1].value = propertyShadow.Suppressed();
+    PublishStatsNP.s = IPS_OK;
+    IDSetNumber(&PublishStatsNP, NULL);
+
+    if(focusDriver != NULL){
+        busStatsProperty.Publish(focusDriver->GetCommandStats());
+    }
+
+    if(worker != NULL){
+        busHealthProperty.Publish(worker->Policy());
+
+        const CMoveCoalescer &moves = worker->Moves();
+        MoveStatsN[0].value = moves.Offered();
+        MoveStatsN[1].value = moves.Sent();
+        MoveStatsN[2].value = moves.Coalesced();
+        MoveStatsNP.s = IPS_OK;
+        IDSetNumber(&MoveStatsNP, NULL);
+    }
+
+    PublishMonitor();
+}
+
 bool FusionFocus::Handshake()
 {
     return true;
@@ -280,34 +869,36 @@ bool FusionFocus::MoveFocuser(unsigned int position)
         return false;
     }
 
-    if(focusDriver != NULL)
-    {
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->SetMove(position);
-
-                // Cache the set position and calculate the anticipated delta
-                setPosition = position;
-                delta = abs(long(position) - long(focusSettings.cur_pos));
-
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "Move Focuser failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
+    if(!Submit(FUSION_MOVE, position)){
+        return false;
+    }
 
-        if(retry==0){
-            return false;
-        }
+    requestedPosition = position;
+    return true;
+}
 
-        return true;
+// Computed from the cached settings, so the move is the only bus
+// transaction.  While a move is under way the step adds to its target,
+// so quick successive steps add up instead of being lost.
+IPState FusionFocus::MoveRelFocuser(FocusDirection dir, uint32_t ticks)
+{
+    long from = FocusAbsPosNP.s == IPS_BUSY ? requestedPosition : focusSettings.cur_pos;
+    long target = dir == FOCUS_INWARD ? from - (long)ticks : from + (long)ticks;
+
+    if(target < 0){
+        target = 0;
+    } else if(target > focusSettings.max_move){
+        target = focusSettings.max_move;
+    }
+
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Relative move of %u steps from %ld to %ld", ticks, from, target);
+
+    if(!MoveFocuser(target)){
+        return IPS_ALERT;
     }
 
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    FocusAbsPosNP.s = IPS_BUSY;
+    return IPS_BUSY;
 }
 
 bool FusionFocus::UpdateMaxTravel(unsigned int position) 
@@ -319,34 +910,12 @@ bool FusionFocus::UpdateMaxTravel(unsigned int position)
         return false;
     }
 
-    if(focusDriver != NULL)
-    {
-        if(position > 65534){
-            position = 65534;
-            DEBUGF(INDI::Logger::DBG_DEBUG, "Position truncated to %d", position);
-        }
-
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->SetMax(position);
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "Set max failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
-
-        if(retry==0){
-            return false;
-        }
-
-        return true;
+    if(position > 65534){
+        position = 65534;
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Position truncated to %d", position);
     }
 
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    return Submit(FUSION_SET_MAX, position);
 }
 
 bool FusionFocus::UpdateCurPos(unsigned int position) {
@@ -356,30 +925,8 @@ bool FusionFocus::UpdateCurPos(unsigned int position) {
         DEBUG(INDI::Logger::DBG_ERROR, "Not Connected!");
         return false;
     }
-    
-    if(focusDriver != NULL)
-    {
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->SetPosition(position);
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "Set position failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
-
-        if(retry==0){
-            return false;
-        }
 
-        return true;
-    }
-
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    return Submit(FUSION_SYNC, position);
 }
 
 bool FusionFocus::UpdateBacklash(unsigned int backlash) {
@@ -389,30 +936,8 @@ bool FusionFocus::UpdateBacklash(unsigned int backlash) {
         DEBUG(INDI::Logger::DBG_ERROR, "Not Connected!");
         return false;
     }
-    
-    if(focusDriver != NULL)
-    {
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->SetBacklash(backlash);
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "SetBacklash failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
-
-        if(retry==0){
-            return false;
-        }
-
-        return true;
-    }
 
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    return Submit(FUSION_SET_BACKLASH, backlash);
 }
 
 bool FusionFocus::UpdateDirection(int inOut) {
@@ -422,30 +947,8 @@ bool FusionFocus::UpdateDirection(int inOut) {
         DEBUG(INDI::Logger::DBG_ERROR, "Not Connected!");
         return false;
     }
-    
-    if(focusDriver != NULL)
-    {
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->SetDir(inOut);
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "SetDir failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
 
-        if(retry==0){
-            return false;
-        }
-
-        return true;
-    }
-
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    return Submit(FUSION_SET_DIR, inOut);
 }
 
 bool FusionFocus::UpdateSpeed(unsigned int speed) {
@@ -462,29 +965,7 @@ bool FusionFocus::UpdateSpeed(unsigned int speed) {
         speed = 5;
     }
 
-    if(focusDriver != NULL)
-    {
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->SetSpeed(speed);
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "SetSpeed failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
-
-        if(retry==0){
-            return false;
-        }
-
-        return true;
-    }
-
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    return Submit(FUSION_SET_SPEED, speed);
 }
 
 bool FusionFocus::AbortFocuser()
@@ -496,112 +977,398 @@ bool FusionFocus::AbortFocuser()
         return false;
     }
 
-    if(focusDriver != NULL)
-    {
-        int retry = 3;
-        while(retry != 0) {
-            try {
-                focusDriver->Abort();
-                break;
-            } catch (CFusionFocusDriver::CFocusException e) {
-                retry--;
-                DEBUGF(INDI::Logger::DBG_ERROR, "Abort failed with error %d, retry %d times", e.m_err);
-                sleep(0.05);
-            }
-        }
+    if(sweep.Active()){
+        DEBUG(INDI::Logger::DBG_SESSION, "Sweep aborted");
+        EndSweep(IPS_ALERT);
+    }
 
-        if(retry==0){
-            return false;
-        }
+    return Submit(FUSION_ABORT, 0);
+}
 
-        return true;
+void FusionFocus::SweepStep()
+{
+    if(sweepTimer != -1){
+        IERmTimer(sweepTimer);
+        sweepTimer = -1;
+    }
+
+    if(!MoveFocuser(sweep.Target())){
+        EndSweep(IPS_ALERT);
+        return;
+    }
+
+    FocusAbsPosNP.s = IPS_BUSY;
+    IDSetNumber(&FocusAbsPosNP, NULL);
+    propertyShadow.Invalidate(FocusAbsPosNP.name);
+}
+
+// Arrival is the first settings read that has the focuser stopped on
+// the target.  The worker wakes for it from the move's ETA, so this
+// usually lands within a poll margin of the motor stopping.
+void FusionFocus::CheckSweep()
+{
+    if(!sweep.Active() || sweepTimer != -1){
+        return;
+    }
+
+    if(focusSettings.cur_pos != focusSettings.set_pos || focusSettings.cur_pos != sweep.Target()){
+        return;
+    }
+
+    unsigned int settleMs = sweepProperty.SettleMs();
+    if(settleMs > 0){
+        sweepTimer = IEAddTimer(settleMs, SweepSettled, this);
+        return;
+    }
+
+    SweepArrived();
+}
+
+void FusionFocus::SweepSettled(void *p)
+{
+    FusionFocus *focus = (FusionFocus *)p;
+
+    focus->sweepTimer = -1;
+    focus->SweepArrived();
+}
+
+void FusionFocus::SweepArrived()
+{
+    if(sweep.AtSample()){
+        sweepProperty.Arrived(sweep);
+    }
+
+    if(sweep.Advance()){
+        SweepStep();
+        return;
+    }
+
+    EndSweep(IPS_OK);
+}
+
+void FusionFocus::EndSweep(IPState state)
+{
+    if(sweepTimer != -1){
+        IERmTimer(sweepTimer);
+        sweepTimer = -1;
+    }
+
+    sweep.Cancel();
+    sweepProperty.Finished(state);
+}
+
+
+
+void FusionFocus::PublishSettings()
+{
+    FocusAbsPosN[0].min = 0.;
+    FocusAbsPosN[0].max = focusSettings.max_move;
+    FocusAbsPosN[0].value = focusSettings.cur_pos;
+    FocusAbsPosN[0].step = 100;
+
+    if(focusSettings.cur_pos != focusSettings.set_pos)
+    {
+        FocusAbsPosNP.s = IPS_BUSY;
+    }
+    else
+    {
+        FocusAbsPosNP.s = IPS_OK;
     }
 
-    DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL");
-    return false;
+    if(FocusRelPosNP.s == IPS_BUSY && FocusAbsPosNP.s == IPS_OK)
+    {
+        FocusRelPosNP.s = IPS_OK;
+    }
+
+    FocusMaxPosN[0].min = 0.;
+    FocusMaxPosN[0].max = 65535;
+    FocusMaxPosN[0].value = focusSettings.max_move;
+    FocusMaxPosN[0].step = 100;
+
+    FocusBacklashN[0].value = focusSettings.backlash;
+
+    FocusSpeedN[0].value = focusSettings.step_timer;
+
+    propertyShadow.SetNumber(&FocusAbsPosNP);
+    propertyShadow.SetNumber(&FocusRelPosNP);
+    propertyShadow.SetNumber(&FocusMaxPosNP);
+    propertyShadow.SetNumber(&FocusBacklashNP);
+    propertyShadow.SetNumber(&FocusSpeedNP);
+
+    propertyShadow.SetSwitch(&FocusReverseSP);
 }
 
+void FusionFocus::ResultsReady(int fd, void *p)
+{
+    INDI_UNUSED(fd);
 
+    FusionFocus *focus = (FusionFocus *)p;
+    FUSION_RESULT result;
 
-void FusionFocus::TimerHit() {
-    // This causes log spamming
-    //DEBUG(INDI::Logger::DBG_DEBUG, "TimerHit");
+    while(focus->worker != NULL && focus->worker->Take(result)){
+        focus->HandleResult(result);
+    }
+}
 
-    static int badHit = 0;
+void FusionFocus::HandleResult(const FUSION_RESULT &result)
+{
+    static const char *opNames[] = { "Move Focuser", "Set position", "Set max", "SetBacklash", "SetDir", "SetSpeed", "Abort" };
 
     if (isConnected() == false) {
         DEBUG(INDI::Logger::DBG_DEBUG, "Not Connected!");
         return;
     }
-    
-    if(focusDriver != NULL)
-    {
-        focusDriver->GetSettings(&focusSettings);
 
-        FocusAbsPosN[0].min = 0.;
-        FocusAbsPosN[0].max = focusSettings.max_move;
-        FocusAbsPosN[0].value = focusSettings.cur_pos;
-        FocusAbsPosN[0].step = 100;
+    PollIntervalN[0].value = result.pollMs;
+    PollIntervalNP.s = IPS_OK;
+    propertyShadow.SetNumber(&PollIntervalNP);
 
-        if(focusSettings.cur_pos != focusSettings.set_pos)
-        {
-            FocusAbsPosNP.s = IPS_BUSY;
-            DEBUGF(INDI::Logger::DBG_DEBUG, "Focus Driver is at %d moving to %d", focusSettings.cur_pos, focusSettings.set_pos);
-
-            // Get the new delta position
-            int new_delta = abs(long(setPosition) - long(focusSettings.cur_pos));
-            if(new_delta > delta){
-                // We have a bad hit.  This may be a timer/update/network lag issue
-                // so keep a count of the hits and retry the move if exceeded.
-                //
-                // Note that this is to help prevent a focuser runway due to a firmware timing issue
-                // believed fixed, but how to test?  This is here ot try to prevent lost nights imaging
-                if(badHit > 0){
-                    // Ignore the first hit as it generatesa lot of false positives due to timing 
-                    // issues with changes in data
-                    DEBUG(INDI::Logger::DBG_ERROR, "Potential focus runway - Monitoring");
-                }
-                
-                badHit++;
-                if(badHit > 2){
-                    // Three seconds of wrong direction = runway.
-                    // Resend the move demand.
-                    MoveFocuser(setPosition);
-                    badHit=0;
-                    DEBUGF(INDI::Logger::DBG_ERROR, "Focus Driver Runaway!  Resending move to %d", setPosition);
-                }
-            } else {
-                // Keep the bad hits at zero.
-                badHit = 0;
-            }
+    CheckBusHealth();
+    CheckWatchdog(result.bus);
+
+    if(result.op == FUSION_ABORT){
+        abortLatencyProperty.Record(result.latencyUs, result.err == 0);
+    }
+
+    if(result.op == FUSION_POLL){
+        if(result.err == FUSION_ERR_CIRCUIT_OPEN){
+            DEBUG(INDI::Logger::DBG_DEBUG, "Status poll skipped, I2C bus backing off");
+            return;
         }
-        else
-        {
-            FocusAbsPosNP.s = IPS_OK;
+
+        if(result.err == FUSION_ERR_PREEMPTED){
+            DEBUG(INDI::Logger::DBG_DEBUG, "Status poll cut short by an abort");
+            return;
+        }
+
+        if(result.err != 0){
+            DEBUGF(INDI::Logger::DBG_ERROR, "Status poll failed with error %d after %d attempts", result.err, result.attempts);
+            return;
+        }
+
+        focusSettings = result.settings;
+        CheckRunaway();
+        UpdateAdc();
+
+        PublishSettings();
+        estimateProperty.Start();
+        CheckSweep();
+        PublishStats();
+        return;
+    }
+
+    // A move the abort cut short was dropped on purpose
+    if(result.err == FUSION_ERR_PREEMPTED){
+        DEBUGF(INDI::Logger::DBG_WARNING, "%s cut short by an abort after %d attempts", opNames[result.op], result.attempts);
+        if(result.op != FUSION_MOVE){
+            SetCommandState(result.op, IPS_ALERT);
+        }
+        return;
+    }
+
+    if(result.err != 0){
+        DEBUGF(INDI::Logger::DBG_ERROR, "%s failed with error %d after %d attempts", opNames[result.op], result.err, result.attempts);
+        SetCommandState(result.op, IPS_ALERT);
+
+        if(result.op == FUSION_MOVE && sweep.Active()){
+            EndSweep(IPS_ALERT);
         }
-        
-        FocusMaxPosN[0].min = 0.;
-        FocusMaxPosN[0].max = 65535;
-        FocusMaxPosN[0].value = focusSettings.max_move;
-        FocusMaxPosN[0].step = 100;
+        return;
+    }
+
+    if(result.attempts > 1){
+        DEBUGF(INDI::Logger::DBG_WARNING, "%s needed %d attempts", opNames[result.op], result.attempts);
+    }
 
-        FocusBacklashN[0].value = focusSettings.backlash;
-        
-        FocusSpeedN[0].value = focusSettings.step_timer;
+    focusSettings = result.settings;
+    UpdateAdc();
+
+    if(result.op == FUSION_MOVE){
+        // Cache the set position for the runaway check
+        setPosition = result.value;
+    }
+
+    // The command carried a settings read, so publish the confirmed state now
+    SetCommandState(result.op, IPS_OK);
+    PublishSettings();
+    estimateProperty.Start();
+    CheckSweep();
+}
+
+// Between polls the estimate runs on the worker's motion model
+bool FusionFocus::MotionState(void *arg, CMotionEstimateProperty::MOTION_STATE &state)
+{
+    FusionFocus *focus = (FusionFocus *)arg;
 
+    if(focus->worker == NULL){
+        return false;
+    }
+
+    state.model = &focus->worker->Motion();
+    state.position = focus->focusSettings.cur_pos;
+    state.key = focus->focusSettings.step_timer;
+    state.moving = focus->focusSettings.cur_pos != focus->focusSettings.set_pos;
+    return true;
+}
+
+// Say when the breaker gives up on the bus and when it comes back; the
+// attempts in between fail fast and only log at debug level.
+void FusionFocus::CheckBusHealth()
+{
+    int state = worker->Policy().State();
+    if(state == busState){
+        return;
+    }
+
+    if(state == CRetryPolicy::OPEN && busState == CRetryPolicy::CLOSED){
+        DEBUG(INDI::Logger::DBG_ERROR, "I2C bus not responding, backing off");
+    } else if(state == CRetryPolicy::CLOSED){
+        DEBUG(INDI::Logger::DBG_SESSION, "I2C bus recovered");
+    }
+
+    busState = state;
+    busHealthProperty.Publish(worker->Policy(), true);
+}
+
+void FusionFocus::ApplyBusTiming()
+{
+    if(focusDriver == NULL){
+        return;
+    }
+
+    I2C_TIMING timing;
+    timing.timeoutMs = I2CTimingN[0].value;
+    timing.retries = I2CTimingN[1].value;
+    timing.deadlineMs = I2CTimingN[2].value;
+
+    focusDriver->SetBusTiming(timing);
+}
+
+// The worker's watchdog recovers the bus itself; this reports it.  A
+// recovery that failed leaves the focuser in an unknown state, so the
+// position goes to alert rather than waiting on a move that may never
+// be reported.
+void FusionFocus::CheckWatchdog(const I2C_STATS &bus)
+{
+    const I2C_STATS &last = watchdogLast;
+
+    if(bus.timingErrors != last.timingErrors){
+        DEBUG(INDI::Logger::DBG_WARNING, "The I2C adapter refused the timeout or retries, it keeps its own");
+        watchdogLast.timingErrors = bus.timingErrors;
+    }
+
+    if(bus.overruns == last.overruns && bus.recoveries == last.recoveries &&
+       bus.failedRecoveries == last.failedRecoveries && bus.maxUs == last.maxUs &&
+       bus.stuck == last.stuck){
+        return;
+    }
+
+    if(bus.recoveries != last.recoveries){
+        DEBUGF(bus.stuck ? INDI::Logger::DBG_ERROR : INDI::Logger::DBG_WARNING,
+               "I2C transaction failed past its %.f ms deadline, bus %s", I2CTimingN[2].value,
+               bus.stuck ? "recovery failed" : "recovered");
+    } else if(bus.overruns != last.overruns){
+        DEBUGF(INDI::Logger::DBG_WARNING, "I2C transaction overran its %.f ms deadline", I2CTimingN[2].value);
+    }
+
+    if(bus.stuck && !last.stuck){
+        FocusAbsPosNP.s = IPS_ALERT;
         IDSetNumber(&FocusAbsPosNP, NULL);
-        IDSetNumber(&FocusMaxPosNP, NULL);
-        IDSetNumber(&FocusBacklashNP, NULL);
-        IDSetNumber(&FocusSpeedNP, NULL);
+    } else if(!bus.stuck && last.stuck){
+        DEBUG(INDI::Logger::DBG_SESSION, "I2C bus responding again");
+    }
+
+    watchdogLast = bus;
+
+    WatchdogN[0].value = bus.overruns;
+    WatchdogN[1].value = bus.recoveries;
+    WatchdogN[2].value = bus.failedRecoveries;
+    WatchdogN[3].value = bus.maxUs / 1000.;
+    WatchdogNP.s = bus.stuck ? IPS_ALERT : IPS_OK;
+    IDSetNumber(&WatchdogNP, NULL);
+}
+
+// The property a client changed to issue a command.  A finished move is
+// reported by PublishSettings from the position itself.
+void FusionFocus::SetCommandState(int op, IPState state)
+{
+    switch(op){
+        case FUSION_MOVE:
+            if(state == IPS_ALERT){
+                FocusAbsPosNP.s = state;
+                IDSetNumber(&FocusAbsPosNP, NULL);
+            }
+            break;
+        case FUSION_SYNC:
+            FocusSyncNP.s = state;
+            IDSetNumber(&FocusSyncNP, NULL);
+            break;
+        case FUSION_SET_MAX:
+            FocusMaxPosNP.s = state;
+            IDSetNumber(&FocusMaxPosNP, NULL);
+            break;
+        case FUSION_SET_BACKLASH:
+            FocusBacklashNP.s = state;
+            IDSetNumber(&FocusBacklashNP, NULL);
+            break;
+        case FUSION_SET_DIR:
+            FocusReverseSP.s = state;
+            IDSetSwitch(&FocusReverseSP, NULL);
+            break;
+        case FUSION_SET_SPEED:
+            FocusSpeedNP.s = state;
+            IDSetNumber(&FocusSpeedNP, NULL);
+            break;
+        case FUSION_ABORT:
+            FocusAbortSP.s = state;
+            IDSetSwitch(&FocusAbortSP, NULL);
+            break;
+    }
+}
 
-        IDSetSwitch(&FocusReverseSP, NULL);
+// Judged against the move that was sent rather than the firmware's own
+// target, which may be what went wrong.  The move's fast poll rate means
+// a fault is acted on within a few hundred ms.
+void FusionFocus::CheckRunaway()
+{
+    bool moving = focusSettings.cur_pos != focusSettings.set_pos;
+    unsigned int target = setPosition >= 0 ? setPosition : focusSettings.set_pos;
+
+    if(moving){
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Focus Driver is at %d moving to %d", focusSettings.cur_pos, focusSettings.set_pos);
     }
-    else
-    {
-        DEBUG(INDI::Logger::DBG_ERROR, "Focus Driver is NULL in TimerHit");
+
+    switch(motionMonitor.Sample(MonotonicUs(), focusSettings.cur_pos, target, moving)){
+        case CMotionMonitor::RESEND:
+            DEBUGF(INDI::Logger::DBG_ERROR, "Focus Driver %s!  Resending move to %u",
+                   motionMonitor.LastWasStall() ? "stalled" : "Runaway", target);
+            MoveFocuser(target);
+            PublishMonitor();
+            break;
+
+        case CMotionMonitor::ABORT:
+            DEBUGF(INDI::Logger::DBG_ERROR, "Focus Driver %s again after resending, aborting the move to %u",
+                   motionMonitor.LastWasStall() ? "stalled" : "ran away", target);
+            AbortFocuser();
+            FocusAbsPosNP.s = IPS_ALERT;
+            IDSetNumber(&FocusAbsPosNP, NULL);
+            PublishMonitor();
+            break;
     }
+}
 
-    SetTimer(POLLMS);
+void FusionFocus::PublishMonitor()
+{
+    const CMotionMonitor::MONITOR_STATS &stats = motionMonitor.Stats();
+
+    MonitorStatsN[0].value = stats.wrongDirection;
+    MonitorStatsN[1].value = stats.stalls;
+    MonitorStatsN[2].value = stats.resends;
+    MonitorStatsN[3].value = stats.aborts;
+    MonitorStatsN[4].value = stats.latency.Mean() / 1000.;
+    MonitorStatsN[5].value = stats.latency.Max() / 1000.;
+    MonitorStatsNP.s = stats.aborts > 0 ? IPS_ALERT : IPS_OK;
+    propertyShadow.SetNumber(&MonitorStatsNP);
 }
 
 
@@ -19,6 +19,16 @@
 #define FUSION_FOCUS_H
 
 #include "fusion-focus-driver.h"
+#include "fusion-worker.h"
+#include "property-shadow.h"
+#include "bus-stats-property.h"
+#include "retry-policy-property.h"
+#include "abort-latency-property.h"
+#include "motion-estimate-property.h"
+#include "telemetry-log-property.h"
+#include "stream-stats.h"
+#include "focus-sweep-property.h"
+#include "motion-monitor.h"
 
 #include "indifocuser.h"
 
@@ -39,21 +49,125 @@ public:
 
     virtual bool ISNewNumber (const char *dev, const char *name, double values[], char *names[], int n);
     virtual bool ISNewSwitch (const char *dev, const char *name, ISState *states, char *names[], int n);
+    virtual bool ISNewText (const char *dev, const char *name, char *texts[], char *names[], int n);
+    virtual void ISGetProperties(const char *dev);
+    virtual bool saveConfigItems(FILE *fp);
 
+    virtual IPState MoveRelFocuser(FocusDirection dir, uint32_t ticks);
     virtual bool AbortFocuser();
-    virtual void TimerHit();
 
 private:
 
-    int timerid;
-
     CFusionFocusDriver *focusDriver;
     FOCUSER focusSettings;
 
+    // Owns the bus while connected; results come back through the
+    // event loop on resultCallback.
+    CFusionWorker *worker;
+    int resultCallback;
+
+    IText I2CBusT[1] {};
+    ITextVectorProperty I2CBusTP;
+
+    INumber I2CAddressN[1];
+    INumberVectorProperty I2CAddressNP;
+
+    // Adapter timeout and retries, and the watchdog deadline
+    INumber I2CTimingN[3];
+    INumberVectorProperty I2CTimingNP;
+
+    // Watchdog overruns and recoveries, as of the last result
+    INumber WatchdogN[4];
+    INumberVectorProperty WatchdogNP;
+    I2C_STATS watchdogLast;
+
+    // Every settings read, recorded by the worker for later analysis
+    CTelemetryLogProperty telemetryProperty;
+
+    INumber PollRatesN[4];
+    INumberVectorProperty PollRatesNP;
+
+    INumber PollIntervalN[1];
+    INumberVectorProperty PollIntervalNP;
+
+    CPropertyShadow propertyShadow;
+    unsigned long long lastStatsMs;
+
+    INumber PublishStatsN[2];
+    INumberVectorProperty PublishStatsNP;
+
+    INumber MoveStatsN[3];
+    INumberVectorProperty MoveStatsNP;
+
+    // Dead-reckoned between polls from the worker's motion model
+    CMotionEstimateProperty estimateProperty;
+
+    // The firmware's averaged ADC inputs, taken from every settings read
+    // that carries a new average
+    CStreamStats adcStats[2];
+    bool adcValid;
+    unsigned char adcDatacount;
+    unsigned long long lastAdcMs;
+
+    INumber AdcStatsN[2][5];
+    INumberVectorProperty AdcStatsNP[2];
+
+    // Linear map from one ADC channel to a temperature; a zero gain
+    // leaves FOCUS_TEMPERATURE undefined.
+    INumber TemperatureCalN[3];
+    INumberVectorProperty TemperatureCalNP;
+    INumber TemperatureN[1];
+    INumberVectorProperty TemperatureNP;
+    bool temperatureDefined;
+
+    // Driver side autofocus sweep; sweepTimer runs the settle delay
+    CFocusSweep sweep;
+    CFocusSweepProperty sweepProperty;
+    int sweepTimer;
+
+    CBusStatsProperty busStatsProperty;
+    CRetryPolicyProperty busHealthProperty;
+    int busState;
+
+    // Abort request to FOCUS_SET_STOP on the bus
+    CAbortLatencyProperty abortLatencyProperty;
+
+    // The target of the last move, -1 until one is sent this session
     int setPosition;
-    int delta;
+
+    // Runaway and stall detection on the status reads of a move
+    CMotionMonitor motionMonitor;
+    INumber MonitorStatsN[6];
+    INumberVectorProperty MonitorStatsNP;
+
+    // The last target sent to the worker; relative moves made while it is
+    // still being reached step from here.
+    unsigned int requestedPosition;
 
     void GetFocusParams();
+    void PublishSettings();
+    void ApplyPollRates();
+
+    bool Submit(int op, unsigned int value);
+    static void ResultsReady(int fd, void *p);
+    void HandleResult(const FUSION_RESULT &result);
+    void SetCommandState(int op, IPState state);
+    void CheckRunaway();
+    void PublishMonitor();
+    void CheckBusHealth();
+    void ApplyBusTiming();
+    void CheckWatchdog(const I2C_STATS &bus);
+    void PublishStats();
+    void UpdateAdc();
+    void PublishAdc();
+    void DefineTemperature();
+
+    void SweepStep();
+    void CheckSweep();
+    static void SweepSettled(void *p);
+    void SweepArrived();
+    void EndSweep(IPState state);
+    static bool MotionState(void *arg, CMotionEstimateProperty::MOTION_STATE &state);
 
     bool MoveFocuser(unsigned int position);
 
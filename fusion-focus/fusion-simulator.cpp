@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fusion-simulator.h"
+#include "fusion-focus-registers.h"
+#include "monotonic-clock.h"
+
+#define SIM_ADDRESS			0x08
+#define SIM_STEP_US			1000
+#define SIM_ADC_BASE		512
+
+I2C_PROBE CFusionSimulator::m_probe = NULL;
+void *CFusionSimulator::m_probeArg = NULL;
+
+void CFusionSimulator::SetProbe(I2C_PROBE probe, void *arg)
+{
+	m_probe = probe;
+	m_probeArg = arg;
+}
+
+CFusionSimulator::CFusionSimulator()
+{
+	m_address = SIM_ADDRESS;
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	memset(&m_state, 0, sizeof(m_state));
+	m_state.cur_pos = 10000;
+	m_state.set_pos = 10000;
+	m_state.max_move = 20000;
+	m_state.microns = 100;
+	m_state.backlash = 20;
+	m_state.step_timer = 1;
+	m_state.adc1_mean = SIM_ADC_BASE;
+	m_state.adc2_mean = SIM_ADC_BASE;
+
+	m_pointer = 0;
+
+	m_lastDir = 0;
+	m_backlashLeft = 0;
+	m_lastStepUs = MonotonicUs();
+	m_carryUs = 0;
+
+	m_failNext = 0;
+	m_errorRate = 0.;
+	m_latencyUs = 0;
+}
+
+// Each transaction costs the simulated bus time, brings the motor up to
+// date and may be failed on request.
+int CFusionSimulator::Begin()
+{
+	m_stats.transactions++;
+	m_stats.syscalls++;
+	m_stats.lastSyscalls = 1;
+
+	if (m_latencyUs != 0)
+	{
+		usleep(m_latencyUs);
+	}
+
+	Advance();
+
+	if (m_failNext > 0 || (m_errorRate > 0. && drand48() < m_errorRate))
+	{
+		if (m_failNext > 0)
+		{
+			m_failNext--;
+		}
+
+		m_stats.errors++;
+		return 100;
+	}
+
+	Sample();
+	return 0;
+}
+
+void CFusionSimulator::Advance()
+{
+	unsigned long long now = MonotonicUs();
+
+	if (m_state.cur_pos == m_state.set_pos && m_backlashLeft == 0)
+	{
+		m_lastStepUs = now;
+		m_carryUs = 0;
+		return;
+	}
+
+	unsigned long long period = (m_state.step_timer ? m_state.step_timer : 1) * SIM_STEP_US;
+	unsigned long long elapsed = now - m_lastStepUs + m_carryUs;
+	unsigned long long steps = elapsed / period;
+
+	m_carryUs = elapsed % period;
+	m_lastStepUs = now;
+
+	// Slack in the gear train is taken up before the draw tube moves
+	unsigned long long takeup = steps < m_backlashLeft ? steps : m_backlashLeft;
+	m_backlashLeft -= takeup;
+	steps -= takeup;
+
+	unsigned int remaining = abs(int(m_state.set_pos) - int(m_state.cur_pos));
+	if (steps > remaining)
+	{
+		steps = remaining;
+	}
+
+	if (m_state.set_pos > m_state.cur_pos)
+	{
+		m_state.cur_pos += steps;
+	}
+	else
+	{
+		m_state.cur_pos -= steps;
+	}
+}
+
+// The firmware averages its ADC inputs between reads; give them a slow
+// drift so there is something to look at.
+void CFusionSimulator::Sample()
+{
+	unsigned long long seconds = MonotonicUs() / 1000000;
+
+	m_state.adc1_mean = SIM_ADC_BASE + (seconds / 60) % 16;
+	m_state.adc2_mean = SIM_ADC_BASE - (seconds / 90) % 16;
+	m_state.datacount++;
+}
+
+void CFusionSimulator::Move(unsigned int target)
+{
+	if (target > m_state.max_move)
+	{
+		target = m_state.max_move;
+	}
+
+	int dir = 0;
+	if (target > m_state.cur_pos)
+	{
+		dir = 1;
+	}
+	else if (target < m_state.cur_pos)
+	{
+		dir = -1;
+	}
+
+	if (dir != 0 && m_lastDir != 0 && dir != m_lastDir)
+	{
+		m_backlashLeft = m_state.backlash;
+	}
+
+	if (dir != 0)
+	{
+		m_lastDir = dir;
+	}
+
+	m_state.set_pos = target;
+	m_lastStepUs = MonotonicUs();
+	m_carryUs = 0;
+}
+
+unsigned int CFusionSimulator::ReadRegister(__u8 command)
+{
+	switch (command)
+	{
+		case FOCUS_GET_POS:			return m_state.cur_pos;
+		case FOCUS_GET_MOVE:		return m_state.set_pos;
+		case FOCUS_GET_MAX:			return m_state.max_move;
+		case FOCUS_GET_MICRON:		return m_state.microns;
+		case FOCUS_GET_DIR:			return m_state.dir;
+		case FOCUS_GET_BACKLASH:	return m_state.backlash;
+		case FOCUS_GET_SPEED:		return m_state.step_timer;
+	}
+
+	return 0;
+}
+
+void CFusionSimulator::WriteRegister(__u8 command, unsigned int value)
+{
+	switch (command)
+	{
+		case FOCUS_SET_POS:
+			m_state.cur_pos = value;
+			m_state.set_pos = value;
+			m_backlashLeft = 0;
+			break;
+		case FOCUS_SET_MOVE:
+			Move(value);
+			break;
+		case FOCUS_SET_STOP:
+			m_state.set_pos = m_state.cur_pos;
+			m_backlashLeft = 0;
+			break;
+		case FOCUS_SET_MAX:
+			m_state.max_move = value;
+			break;
+		case FOCUS_SET_MICRON:
+			m_state.microns = value;
+			break;
+		case FOCUS_SET_DIR:
+			m_state.dir = value;
+			break;
+		case FOCUS_SET_BACKLASH:
+			m_state.backlash = value;
+			break;
+		case FOCUS_SET_SPEED:
+			m_state.step_timer = value;
+			break;
+	}
+
+	if (m_probe != NULL)
+	{
+		m_probe(command, m_probeArg);
+	}
+}
+
+int CFusionSimulator::SmbusAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data)
+{
+	int err = Begin();
+	if (err != 0)
+	{
+		return err;
+	}
+
+	if (read_write == I2C_SMBUS_READ)
+	{
+		unsigned int value = ReadRegister(command);
+		if (size == I2C_SMBUS_WORD_DATA)
+		{
+			data->word = value;
+		}
+		else
+		{
+			data->byte = value;
+		}
+	}
+	else
+	{
+		WriteRegister(command, size == I2C_SMBUS_WORD_DATA ? data->word : data->byte);
+	}
+
+	return 0;
+}
+
+// A write of one byte sets the register pointer for the read that
+// follows; longer writes carry a byte or little endian word value.
+int CFusionSimulator::Transfer(struct i2c_msg *msgs, int nmsgs)
+{
+	int err = Begin();
+	if (err != 0)
+	{
+		return 500;
+	}
+
+	for (int i = 0; i < nmsgs; i++)
+	{
+		struct i2c_msg *msg = &msgs[i];
+
+		if (msg->addr != m_address)
+		{
+			m_stats.errors++;
+			return 500;
+		}
+
+		if (msg->flags & I2C_M_RD)
+		{
+			if (m_pointer == FOCUS_GET_SETTINGS)
+			{
+				int len = msg->len < sizeof(FOCUSER) ? msg->len : sizeof(FOCUSER);
+				memcpy(msg->buf, &m_state, len);
+			}
+			else
+			{
+				unsigned int value = ReadRegister(m_pointer);
+				msg->buf[0] = value & 0x00FF;
+				if (msg->len > 1)
+				{
+					msg->buf[1] = (value & 0xFF00) >> 8;
+				}
+			}
+		}
+		else if (msg->len > 0)
+		{
+			m_pointer = msg->buf[0];
+
+			if (msg->len == 2)
+			{
+				WriteRegister(m_pointer, msg->buf[1]);
+			}
+			else if (msg->len >= 3)
+			{
+				WriteRegister(m_pointer, msg->buf[1] + (msg->buf[2] << 8));
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+
+#include "i2c-transport.h"
+#include "fusion-focus-driver.h"
+
+
+#ifndef __FUSION_SIMULATOR_H
+#define __FUSION_SIMULATOR_H
+
+// Called with the command byte of every write the simulator accepts.
+// Lets benchmarks see exactly when a command reaches the "device".
+typedef void (*I2C_PROBE)(__u8 command, void *arg);
+
+// In-process stand in for a Fusion board, so the driver can run without
+// a Pi.  Models the register map and settings block, moves the motor
+// one step every step_timer ms, takes up backlash on a reversal, and
+// can be told to fail bus transactions.
+class CFusionSimulator : public CI2CTransport
+{
+public:
+    CFusionSimulator();
+
+    int SmbusAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data);
+    int Transfer(struct i2c_msg *msgs, int nmsgs);
+
+    void Close() {}
+
+    __u16 Address() const { return m_address; }
+    const I2C_STATS &Stats() const { return m_stats; }
+
+    // Fail the next count transactions.
+    void InjectErrors(unsigned int count) { m_failNext = count; }
+    // Fail each transaction with the given probability, 0 to 1.
+    void SetErrorRate(double rate) { m_errorRate = rate; }
+    // Time each transaction takes on the simulated bus.
+    void SetLatency(unsigned int us) { m_latencyUs = us; }
+
+    static void SetProbe(I2C_PROBE probe, void *arg);
+
+private:
+    __u16 m_address;
+    I2C_STATS m_stats;
+
+    FOCUSER m_state;
+    __u8 m_pointer;
+
+    int m_lastDir;
+    unsigned int m_backlashLeft;
+    unsigned long long m_lastStepUs;
+    unsigned long long m_carryUs;
+
+    unsigned int m_failNext;
+    double m_errorRate;
+    unsigned int m_latencyUs;
+
+    static I2C_PROBE m_probe;
+    static void *m_probeArg;
+
+    int Begin();
+    void Advance();
+    void Sample();
+
+    unsigned int ReadRegister(__u8 command);
+    void WriteRegister(__u8 command, unsigned int value);
+    void Move(unsigned int target);
+};
+
+
+#endif
@@ -0,0 +1,377 @@
+#include <unistd.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+
+#include "fusion-worker.h"
+#include "monotonic-clock.h"
+
+#define RESULT_WAIT_US		1000
+// Poll this long after the estimated arrival, and never sooner than
+// the floor while the estimate says the focuser is already there
+#define ARRIVAL_MARGIN_MS	5
+#define ARRIVAL_MIN_MS		10
+
+const char *const fusionTelemetryFields[FUSION_TELEMETRY_FIELDS] = {
+	"cur_pos", "set_pos", "adc1_mean", "adc2_mean", "datacount", "step_timer"
+};
+
+CFusionWorker::CFusionWorker(CFusionFocusDriver *driver, CTelemetryLog *log)
+{
+	m_driver = driver;
+	m_log = log;
+	m_running = false;
+
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	m_resultFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	m_abortPending = false;
+	m_abortUs = 0;
+
+	m_nextPollMs = 0;
+	m_moving = false;
+}
+
+CFusionWorker::~CFusionWorker()
+{
+	Stop();
+
+	close(m_wakeFd);
+	close(m_resultFd);
+}
+
+bool CFusionWorker::Start(const FOCUSER &settings)
+{
+	if (m_running || m_wakeFd < 0 || m_resultFd < 0)
+	{
+		return false;
+	}
+
+	m_moving = settings.cur_pos != settings.set_pos;
+	Observe(settings);
+	m_nextPollMs = MonotonicMs() + m_scheduler.Next(m_moving);
+
+	m_running = true;
+	if (pthread_create(&m_thread, NULL, Main, this) != 0)
+	{
+		m_running = false;
+		return false;
+	}
+
+	return true;
+}
+
+void CFusionWorker::Stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_running = false;
+	Signal(m_wakeFd);
+	pthread_join(m_thread, NULL);
+}
+
+bool CFusionWorker::Submit(const FUSION_COMMAND &command)
+{
+	if (command.op == FUSION_MOVE && !m_moves.Offer(command.value))
+	{
+		// Replaced a target not yet sent; its queued move carries this one
+		return true;
+	}
+
+	// Abort goes around the queue: whatever is retrying on the bus stops
+	// at its next attempt and the worker runs the abort first.  The
+	// preempt goes before the pending flag, so the ClearPreempt in
+	// TakeAbort always follows the preempt it pairs with.
+	if (command.op == FUSION_ABORT)
+	{
+		m_moves.Cancel();
+		m_abortUs = MonotonicUs();
+		m_policy.Preempt();
+		m_abortPending.store(true, std::memory_order_release);
+
+		Signal(m_wakeFd);
+		return true;
+	}
+
+	if (!m_commands.Push(command))
+	{
+		if (command.op == FUSION_MOVE)
+		{
+			m_moves.Cancel();
+		}
+
+		return false;
+	}
+
+	Signal(m_wakeFd);
+	return true;
+}
+
+bool CFusionWorker::Take(FUSION_RESULT &result)
+{
+	if (m_results.Pop(result))
+	{
+		return true;
+	}
+
+	// Only clear the wakeup once the queue looks empty, then look again
+	// in case a result landed in between.
+	Drain(m_resultFd);
+	return m_results.Pop(result);
+}
+
+void CFusionWorker::Signal(int fd)
+{
+	uint64_t one = 1;
+	if (write(fd, &one, sizeof(one)) != sizeof(one))
+	{
+		// The counter is already non-zero, so the other side will wake
+	}
+}
+
+void CFusionWorker::Drain(int fd)
+{
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) != sizeof(count))
+	{
+		// Nothing was pending
+	}
+}
+
+void *CFusionWorker::Main(void *arg)
+{
+	((CFusionWorker *)arg)->Run();
+	return NULL;
+}
+
+void CFusionWorker::Run()
+{
+	while (m_running)
+	{
+		unsigned long long now = MonotonicMs();
+
+		if (now < m_nextPollMs)
+		{
+			struct pollfd pfd;
+			pfd.fd = m_wakeFd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+
+			poll(&pfd, 1, m_nextPollMs - now);
+		}
+
+		Drain(m_wakeFd);
+
+		// A pending abort goes first, ahead of every queued command
+		FUSION_COMMAND command;
+		while (m_running && (TakeAbort(command) || m_commands.Pop(command)))
+		{
+			Execute(command);
+		}
+
+		if (m_running && MonotonicMs() >= m_nextPollMs)
+		{
+			Poll();
+		}
+	}
+}
+
+void CFusionWorker::Execute(const FUSION_COMMAND &command)
+{
+	if (command.op == FUSION_POLL_RATES)
+	{
+		m_scheduler.SetRates(command.rates[0], command.rates[1], command.rates[2], command.rates[3]);
+		return;
+	}
+
+	FUSION_RESULT result;
+	memset(&result, 0, sizeof(result));
+	result.op = command.op;
+	result.value = command.value;
+
+	// Nothing to do if an abort dropped the target after it was queued
+	if (command.op == FUSION_MOVE && !m_moves.Take(result.value))
+	{
+		return;
+	}
+
+	bool urgent = command.op == FUSION_ABORT;
+
+	bool ok;
+	result.attempts = m_policy.Run([&]() -> bool
+	{
+		// Retry with whatever the client asked for in the meantime
+		if (command.op == FUSION_MOVE)
+		{
+			m_moves.Take(result.value);
+		}
+
+		try
+		{
+			switch (command.op)
+			{
+				case FUSION_MOVE:			m_driver->SetMove(result.value, &result.settings); break;
+				case FUSION_SYNC:			m_driver->SetPosition(command.value, &result.settings); break;
+				case FUSION_SET_MAX:		m_driver->SetMax(command.value, &result.settings); break;
+				case FUSION_SET_BACKLASH:	m_driver->SetBacklash(command.value, &result.settings); break;
+				case FUSION_SET_DIR:		m_driver->SetDir(command.value, &result.settings); break;
+				case FUSION_SET_SPEED:		m_driver->SetSpeed(command.value, &result.settings); break;
+				case FUSION_ABORT:			m_driver->Abort(&result.settings); break;
+			}
+
+			return true;
+		}
+		catch (CFusionFocusDriver::CFocusException e)
+		{
+			result.err = e.m_err;
+			return false;
+		}
+	}, ok, urgent);
+
+	result.err = Outcome(ok, result.err);
+
+	if (urgent)
+	{
+		result.latencyUs = MonotonicUs() - m_abortUs;
+	}
+
+	if (result.err == 0)
+	{
+		m_moving = result.settings.cur_pos != result.settings.set_pos;
+		Observe(result.settings);
+
+		// Start watching a move at the fast rate straight away
+		if (command.op == FUSION_MOVE)
+		{
+			m_scheduler.Moved();
+			m_nextPollMs = MonotonicMs() + NextPoll(m_scheduler.Current());
+		}
+	}
+
+	result.pollMs = m_scheduler.Current();
+	result.bus = m_driver->GetBusStats();
+	Post(result);
+}
+
+// Turns a pending abort into the next command to run, and lets the
+// policy retry again now that the abort has the bus.
+bool CFusionWorker::TakeAbort(FUSION_COMMAND &command)
+{
+	if (!m_abortPending.exchange(false, std::memory_order_acquire))
+	{
+		return false;
+	}
+
+	m_policy.ClearPreempt();
+
+	memset(&command, 0, sizeof(command));
+	command.op = FUSION_ABORT;
+	return true;
+}
+
+void CFusionWorker::Poll()
+{
+	FUSION_RESULT result;
+	memset(&result, 0, sizeof(result));
+	result.op = FUSION_POLL;
+	result.attempts = 1;
+
+	bool ok;
+	result.attempts = m_policy.Run([&]() -> bool
+	{
+		try
+		{
+			m_driver->GetSettings(&result.settings);
+			return true;
+		}
+		catch (CFusionFocusDriver::CFocusException e)
+		{
+			result.err = e.m_err;
+			return false;
+		}
+	}, ok);
+
+	result.err = Outcome(ok, result.err);
+	if (ok)
+	{
+		m_moving = result.settings.cur_pos != result.settings.set_pos;
+		Observe(result.settings);
+	}
+
+	result.pollMs = NextPoll(m_scheduler.Next(m_moving));
+	m_nextPollMs = MonotonicMs() + result.pollMs;
+	result.bus = m_driver->GetBusStats();
+
+	Post(result);
+}
+
+void CFusionWorker::Observe(const FOCUSER &settings)
+{
+	unsigned long long us = MonotonicUs();
+
+	m_motion.Sample(us, settings.cur_pos, settings.set_pos, m_moving, settings.step_timer);
+
+	if (m_log != NULL)
+	{
+		long values[FUSION_TELEMETRY_FIELDS] = { settings.cur_pos, settings.set_pos, settings.adc1_mean, settings.adc2_mean, settings.datacount, settings.step_timer };
+		m_log->Append(us, values);
+	}
+}
+
+// Wake for the arrival of a move rather than a whole poll interval
+// after it, once the step rate for its speed is known.
+unsigned int CFusionWorker::NextPoll(unsigned int intervalMs) const
+{
+	CMotionModel::MOTION_ESTIMATE estimate;
+	if (!m_moving || !m_motion.Estimate(MonotonicUs(), estimate))
+	{
+		return intervalMs;
+	}
+
+	unsigned int arrivalMs = estimate.etaMs + ARRIVAL_MARGIN_MS;
+	if (arrivalMs < ARRIVAL_MIN_MS)
+	{
+		arrivalMs = ARRIVAL_MIN_MS;
+	}
+
+	return arrivalMs < intervalMs ? arrivalMs : intervalMs;
+}
+
+// The error a result reports: none on success, the last attempt's
+// error, FUSION_ERR_PREEMPTED when an abort stopped the retries, or
+// FUSION_ERR_CIRCUIT_OPEN when the breaker allowed no attempt.
+int CFusionWorker::Outcome(bool ok, int err) const
+{
+	if (ok)
+	{
+		return 0;
+	}
+
+	if (m_policy.Preempted())
+	{
+		return FUSION_ERR_PREEMPTED;
+	}
+
+	return err != 0 ? err : FUSION_ERR_CIRCUIT_OPEN;
+}
+
+// Results are never dropped: if the INDI thread has fallen a whole queue
+// behind, wait for it rather than lose a command's outcome.
+void CFusionWorker::Post(const FUSION_RESULT &result)
+{
+	while (!m_results.Push(result))
+	{
+		if (!m_running)
+		{
+			return;
+		}
+
+		usleep(RESULT_WAIT_US);
+	}
+
+	Signal(m_resultFd);
+}
@@ -0,0 +1,140 @@
+
+#ifndef __FUSION_WORKER_H
+#define __FUSION_WORKER_H
+
+#include <pthread.h>
+#include <atomic>
+
+#include "fusion-focus-driver.h"
+#include "poll-scheduler.h"
+#include "spsc-queue.h"
+#include "move-coalescer.h"
+#include "retry-policy.h"
+#include "motion-model.h"
+#include "telemetry-log.h"
+
+// Result error when the bus breaker is open and nothing was tried
+#define FUSION_ERR_CIRCUIT_OPEN		700
+// Result error when an abort cut the command's retries short
+#define FUSION_ERR_PREEMPTED		701
+
+// Names of the settings the worker logs, in record order
+#define FUSION_TELEMETRY_FIELDS		6
+extern const char *const fusionTelemetryFields[FUSION_TELEMETRY_FIELDS];
+
+enum
+{
+    FUSION_MOVE,
+    FUSION_SYNC,
+    FUSION_SET_MAX,
+    FUSION_SET_BACKLASH,
+    FUSION_SET_DIR,
+    FUSION_SET_SPEED,
+    FUSION_ABORT,
+    FUSION_POLL_RATES,
+    FUSION_POLL
+};
+
+typedef struct _fusion_command {
+    int op;
+    unsigned int value;
+    // FUSION_POLL_RATES: fast, settle, idle min, idle max in ms
+    unsigned int rates[4];
+} FUSION_COMMAND;
+
+typedef struct _fusion_result {
+    int op;
+    unsigned int value;
+    // Zero on success, otherwise the error of the last attempt
+    int err;
+    int attempts;
+    // Device state read back by the command, valid when err is zero
+    FOCUSER settings;
+    // Interval to the next status poll
+    unsigned int pollMs;
+    // FUSION_ABORT: time from Submit until the bus took the stop
+    unsigned long long latencyUs;
+    // Bus totals as of this result, watchdog included
+    I2C_STATS bus;
+} FUSION_RESULT;
+
+// Owns the Fusion bus on a thread of its own so a slow or clock
+// stretched bus never holds up the INDI event loop.  Commands go in and
+// results come out through lock-free queues; the status poll runs on
+// the same thread between commands.
+//
+// Submit, Take and ResultFd belong to the INDI thread.
+class CFusionWorker
+{
+public:
+    // The driver and log are borrowed and must outlive the worker.  Every
+    // settings read is appended to the log while it is open.
+    CFusionWorker(CFusionFocusDriver *driver, CTelemetryLog *log = NULL);
+    ~CFusionWorker();
+
+    bool Start(const FOCUSER &settings);
+    void Stop();
+
+    // False if the queue is full.  A move replaces any move still
+    // waiting in the queue or retrying on the bus.  An abort never
+    // queues: it drops any pending move, cuts short the retries of the
+    // command on the bus and runs before anything else in the queue.
+    bool Submit(const FUSION_COMMAND &command);
+    bool Take(FUSION_RESULT &result);
+
+    // Readable while results are waiting
+    int ResultFd() const { return m_resultFd; }
+
+    const CMoveCoalescer &Moves() const { return m_moves; }
+    const CRetryPolicy &Policy() const { return m_policy; }
+
+    // Calibrated from every settings read; safe to query from any thread
+    const CMotionModel &Motion() const { return m_motion; }
+
+private:
+    enum { QUEUE_SIZE = 32 };
+
+    CFusionFocusDriver *m_driver;
+    CTelemetryLog *m_log;
+
+    pthread_t m_thread;
+    std::atomic<bool> m_running;
+
+    CSpscQueue<FUSION_COMMAND, QUEUE_SIZE> m_commands;
+    CSpscQueue<FUSION_RESULT, QUEUE_SIZE> m_results;
+    int m_wakeFd;
+    int m_resultFd;
+
+    // The latest move target; a FUSION_MOVE in the queue only marks that
+    // one is due.
+    CMoveCoalescer m_moves;
+
+    // Retries and the bus breaker for commands and polls alike
+    CRetryPolicy m_policy;
+
+    // Step rate per speed setting, learned from the reads below
+    CMotionModel m_motion;
+
+    // Set by Submit for an abort, taken by the worker
+    std::atomic<bool> m_abortPending;
+    std::atomic<unsigned long long> m_abortUs;
+
+    // Worker thread only
+    CPollScheduler m_scheduler;
+    unsigned long long m_nextPollMs;
+    bool m_moving;
+
+    static void *Main(void *arg);
+    void Run();
+    void Execute(const FUSION_COMMAND &command);
+    bool TakeAbort(FUSION_COMMAND &command);
+    void Poll();
+    void Observe(const FOCUSER &settings);
+    unsigned int NextPoll(unsigned int intervalMs) const;
+    void Post(const FUSION_RESULT &result);
+    int Outcome(bool ok, int err) const;
+    void Signal(int fd);
+    static void Drain(int fd);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <errno.h>
+#include <map>
+
+#include "i2c-bus.h"
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, CI2CBus *> registry;
+
+CI2CBus::CI2CBus(const char *device)
+{
+	m_device = device;
+	m_refs = 0;
+	m_contended = 0;
+
+	// The adapter keeps its own timeout and retries until told otherwise
+	m_timeoutMs = 0;
+	m_retries = 0;
+	m_timingSeq = 0;
+	m_appliedSeq = 0;
+
+	pthread_mutex_init(&m_lock, NULL);
+	pthread_mutex_init(&m_timingLock, NULL);
+}
+
+CI2CBus::~CI2CBus()
+{
+	pthread_mutex_destroy(&m_timingLock);
+	pthread_mutex_destroy(&m_lock);
+}
+
+CI2CBus *CI2CBus::Acquire(const char *device)
+{
+	pthread_mutex_lock(&registryLock);
+
+	CI2CBus *&bus = registry[device];
+	if (bus == NULL)
+	{
+		bus = new CI2CBus(device);
+	}
+	bus->m_refs++;
+
+	pthread_mutex_unlock(&registryLock);
+
+	return bus;
+}
+
+void CI2CBus::Release(CI2CBus *bus)
+{
+	pthread_mutex_lock(&registryLock);
+
+	if (--bus->m_refs == 0)
+	{
+		registry.erase(bus->m_device);
+		delete bus;
+	}
+
+	pthread_mutex_unlock(&registryLock);
+}
+
+void CI2CBus::Lock()
+{
+	if (pthread_mutex_trylock(&m_lock) == EBUSY)
+	{
+		pthread_mutex_lock(&m_lock);
+		m_contended++;
+	}
+}
+
+void CI2CBus::Unlock()
+{
+	pthread_mutex_unlock(&m_lock);
+}
+
+void CI2CBus::SetTiming(unsigned int timeoutMs, unsigned int retries)
+{
+	pthread_mutex_lock(&m_timingLock);
+
+	m_timeoutMs = timeoutMs;
+	m_retries = retries;
+	m_timingSeq++;
+
+	pthread_mutex_unlock(&m_timingLock);
+}
+
+bool CI2CBus::TakeTiming(unsigned int &timeoutMs, unsigned int &retries)
+{
+	pthread_mutex_lock(&m_timingLock);
+
+	bool changed = (m_timingSeq != m_appliedSeq);
+	m_appliedSeq = m_timingSeq;
+	timeoutMs = m_timeoutMs;
+	retries = m_retries;
+
+	pthread_mutex_unlock(&m_timingLock);
+
+	return changed && timeoutMs != 0;
+}
@@ -0,0 +1,66 @@
+
+#include <pthread.h>
+#include <string>
+
+
+#ifndef __I2C_BUS_H
+#define __I2C_BUS_H
+
+// One per adapter device path, shared by every session on that bus.
+// Holding the lock gives a session the bus for a whole transaction, so
+// focusers on the same /dev/i2c-N take turns while those on different
+// buses run in parallel.
+class CI2CBus
+{
+public:
+    // Reference counted; every Acquire needs a Release
+    static CI2CBus *Acquire(const char *device);
+    static void Release(CI2CBus *bus);
+
+    void Lock();
+    void Unlock();
+
+    const char *Device() const { return m_device.c_str(); }
+
+    // Transactions that found the bus held by another session
+    unsigned long Contended() const { return m_contended; }
+
+    // Adapter timeout and retries for every session on the bus; the
+    // last call wins.  Safe from any thread.
+    void SetTiming(unsigned int timeoutMs, unsigned int retries);
+    // With the bus held: a change not yet applied to the adapter.  False
+    // when there is none, or the adapter is to keep its own settings.
+    bool TakeTiming(unsigned int &timeoutMs, unsigned int &retries);
+
+private:
+    CI2CBus(const char *device);
+    ~CI2CBus();
+
+    std::string m_device;
+    int m_refs;
+
+    pthread_mutex_t m_lock;
+    unsigned long m_contended;
+
+    pthread_mutex_t m_timingLock;
+    unsigned int m_timeoutMs;
+    unsigned int m_retries;
+    unsigned long m_timingSeq;
+    // Bus lock held
+    unsigned long m_appliedSeq;
+};
+
+
+// Holds a bus for the life of a scope
+class CI2CBusLock
+{
+public:
+    CI2CBusLock(CI2CBus *bus) : m_bus(bus) { m_bus->Lock(); }
+    ~CI2CBusLock() { m_bus->Unlock(); }
+
+private:
+    CI2CBus *m_bus;
+};
+
+
+#endif
@@ -0,0 +1,332 @@
+#include <unistd.h>				//Needed for I2C port
+#include <fcntl.h>				//Needed for I2C port
+#include <sys/ioctl.h>			//Needed for I2C port
+#include <linux/i2c-dev.h>		//Needed for I2C port
+#include <string.h>
+
+#include "i2c-session.h"
+#include "monotonic-clock.h"
+
+// Watchdog deadline until SetTiming gives one
+#define DEFAULT_DEADLINE_MS	250
+
+CI2CSession::CI2CSession(const char *device, __u16 address)
+{
+	m_bus = CI2CBus::Acquire(device);
+	m_address = address;
+	m_file = -1;
+
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	m_deadlineMs = DEFAULT_DEADLINE_MS;
+}
+
+CI2CSession::~CI2CSession()
+{
+	Close();
+	CI2CBus::Release(m_bus);
+}
+
+void CI2CSession::Close()
+{
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+}
+
+void CI2CSession::SetTiming(const I2C_TIMING &timing)
+{
+	m_deadlineMs = timing.deadlineMs;
+	m_bus->SetTiming(timing.timeoutMs, timing.retries);
+}
+
+// Called with the bus held.  The settings stay with the adapter across
+// descriptors, so they only go out when they change.  I2C_TIMEOUT
+// counts in units of 10ms.
+void CI2CSession::ApplyTiming()
+{
+	unsigned int timeoutMs, retries;
+	if (!m_bus->TakeTiming(timeoutMs, retries))
+	{
+		return;
+	}
+
+	m_stats.lastSyscalls++;
+	if (ioctl(m_file, I2C_TIMEOUT, (unsigned long)((timeoutMs + 9) / 10)) < 0)
+	{
+		m_stats.timingErrors++;
+	}
+
+	m_stats.lastSyscalls++;
+	if (ioctl(m_file, I2C_RETRIES, (unsigned long)retries) < 0)
+	{
+		m_stats.timingErrors++;
+	}
+}
+
+// Start a transaction, opening and addressing the bus if we do not
+// already hold it.
+int CI2CSession::Begin()
+{
+	m_stats.transactions++;
+	m_stats.lastSyscalls = 0;
+
+	if (m_file < 0)
+	{
+		int err = Open();
+		if (err != 0)
+		{
+			return err;
+		}
+	}
+
+	ApplyTiming();
+
+	return 0;
+}
+
+int CI2CSession::Open()
+{
+	m_stats.opens++;
+	m_stats.lastSyscalls++;
+	if ((m_file = open(m_bus->Device(), O_RDWR)) < 0)
+	{
+		m_file = -1;
+		m_stats.errors++;
+		return 200;
+	}
+
+	m_stats.lastSyscalls++;
+	if (ioctl(m_file, I2C_SLAVE, m_address) < 0)
+	{
+		Fail();
+		return 250;
+	}
+
+	return 0;
+}
+
+// A failed transfer may leave the adapter in an odd state, so drop the
+// descriptor and let the next transaction start clean.
+void CI2CSession::Fail()
+{
+	m_stats.errors++;
+	m_stats.lastSyscalls++;
+	Close();
+}
+
+// The watchdog: a transaction that failed after overrunning its
+// deadline may have left the slave holding the bus, so recover before
+// the next one.  One that overran but succeeded had the bus to the end
+// and is only counted.
+int CI2CSession::Finish(int err, unsigned long long startUs)
+{
+	unsigned long long us = MonotonicUs() - startUs;
+	if (us > m_stats.maxUs)
+	{
+		m_stats.maxUs = us;
+	}
+
+	unsigned int deadlineMs = m_deadlineMs;
+	if (deadlineMs == 0 || us <= deadlineMs * 1000ULL)
+	{
+		if (err == 0)
+		{
+			m_stats.stuck = false;
+		}
+
+		return err;
+	}
+
+	m_stats.overruns++;
+
+	if (err == 0)
+	{
+		m_stats.stuck = false;
+		return 0;
+	}
+
+	m_stats.stuck = !Recover();
+
+	return I2C_ERR_DEADLINE;
+}
+
+// Reopen the bus and address the slave with an SMBus quick write.  The
+// adapter timeout bounds the probe as it does any transaction.
+bool CI2CSession::Recover()
+{
+	m_stats.recoveries++;
+
+	if (m_file >= 0)
+	{
+		m_stats.lastSyscalls++;
+		Close();
+	}
+
+	if (Open() != 0)
+	{
+		m_stats.failedRecoveries++;
+		return false;
+	}
+
+	struct i2c_smbus_ioctl_data args;
+
+	args.read_write = I2C_SMBUS_WRITE;
+	args.command = 0;
+	args.size = I2C_SMBUS_QUICK;
+	args.data = NULL;
+
+	m_stats.lastSyscalls++;
+	if (ioctl(m_file, I2C_SMBUS, &args) == -1)
+	{
+		Fail();
+		m_stats.failedRecoveries++;
+		return false;
+	}
+
+	return true;
+}
+
+int CI2CSession::SmbusAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data)
+{
+	CI2CBusLock lock(m_bus);
+
+	int err = Begin();
+	if (err != 0)
+	{
+		m_stats.syscalls += m_stats.lastSyscalls;
+		return err;
+	}
+
+	struct i2c_smbus_ioctl_data args;
+
+	args.read_write = read_write;
+	args.command = command;
+	args.size = size;
+	args.data = data;
+
+	unsigned long long start = MonotonicUs();
+
+	m_stats.lastSyscalls++;
+	if (ioctl(m_file, I2C_SMBUS, &args) == -1)
+	{
+		Fail();
+		err = 100;
+	}
+
+	err = Finish(err, start);
+
+	m_stats.syscalls += m_stats.lastSyscalls;
+	return err;
+}
+
+int CI2CSession::Transfer(struct i2c_msg *msgs, int nmsgs)
+{
+	CI2CBusLock lock(m_bus);
+
+	int err = Begin();
+	if (err != 0)
+	{
+		m_stats.syscalls += m_stats.lastSyscalls;
+		return err;
+	}
+
+	struct i2c_rdwr_ioctl_data rdwr;
+	rdwr.msgs = msgs;
+	rdwr.nmsgs = nmsgs;
+
+	unsigned long long start = MonotonicUs();
+
+	m_stats.lastSyscalls++;
+	if (ioctl(m_file, I2C_RDWR, &rdwr) < 0)
+	{
+		Fail();
+		err = 500;
+	}
+
+	err = Finish(err, start);
+
+	m_stats.syscalls += m_stats.lastSyscalls;
+	return err;
+}
+
+
+CI2CTransaction::CI2CTransaction(__u16 address)
+{
+	m_address = address;
+	m_count = 0;
+	m_overflow = 0;
+}
+
+bool CI2CTransaction::Reserve(int nmsgs)
+{
+	if (m_count + nmsgs > I2C_MAX_MSGS)
+	{
+		m_overflow = 1;
+		return false;
+	}
+
+	return true;
+}
+
+void CI2CTransaction::Add(__u16 flags, __u8 *buf, int len)
+{
+	m_msgs[m_count].addr = m_address;
+	m_msgs[m_count].flags = flags;
+	m_msgs[m_count].len = len;
+	m_msgs[m_count].buf = buf;
+	m_count++;
+}
+
+CI2CTransaction &CI2CTransaction::WriteByte(__u8 command, __u8 value)
+{
+	if (Reserve(1))
+	{
+		__u8 *out = m_out[m_count];
+		out[0] = command;
+		out[1] = value;
+		Add(0, out, 2);
+	}
+
+	return *this;
+}
+
+// Same wire format as an SMBus word write: command, LSB, MSB.
+CI2CTransaction &CI2CTransaction::WriteWord(__u8 command, __u16 value)
+{
+	if (Reserve(1))
+	{
+		__u8 *out = m_out[m_count];
+		out[0] = command;
+		out[1] = value & 0x00FF;
+		out[2] = (value & 0xFF00) >> 8;
+		Add(0, out, 3);
+	}
+
+	return *this;
+}
+
+CI2CTransaction &CI2CTransaction::Read(__u8 command, __u8 *buffer, int buflen)
+{
+	if (Reserve(2))
+	{
+		__u8 *out = m_out[m_count];
+		out[0] = command;
+		Add(0, out, 1);
+		Add(I2C_M_RD, buffer, buflen);
+	}
+
+	return *this;
+}
+
+int CI2CTransaction::Execute(CI2CTransport &transport)
+{
+	if (m_overflow || m_count == 0)
+	{
+		return 600;
+	}
+
+	return transport.Transfer(m_msgs, m_count);
+}
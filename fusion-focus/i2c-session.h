@@ -0,0 +1,85 @@
+
+#include <atomic>
+
+#include "i2c-transport.h"
+#include "i2c-bus.h"
+
+
+#ifndef __I2C_SESSION_H
+#define __I2C_SESSION_H
+
+// Long lived connection to a single slave on an I2C bus.  The file
+// descriptor is opened on first use and kept until the session is
+// destroyed.  Any failed transfer drops the descriptor so the next
+// transaction reopens the bus from scratch.  Each transaction holds the
+// shared CI2CBus for its device.
+//
+// The adapter timeout bounds how long a stuck slave or a stretched clock
+// can hold a transaction.  A watchdog times every transaction against a
+// deadline; a failed one that overruns it is followed by a bus
+// recovery: the descriptor is reopened and the slave is probed with an
+// SMBus quick write, which clocks a full start and stop onto the bus.
+// The adapter timeout is kept on the shared CI2CBus and applied once
+// per change, whichever session next holds the bus.
+class CI2CSession : public CI2CTransport
+{
+public:
+    CI2CSession(const char *device, __u16 address);
+    ~CI2CSession();
+
+    int SmbusAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data);
+    int Transfer(struct i2c_msg *msgs, int nmsgs);
+
+    void Close();
+    void SetTiming(const I2C_TIMING &timing);
+
+    __u16 Address() const { return m_address; }
+    const I2C_STATS &Stats() const { return m_stats; }
+
+private:
+    CI2CBus *m_bus;
+    __u16 m_address;
+    int m_file;
+
+    I2C_STATS m_stats;
+
+    std::atomic<unsigned int> m_deadlineMs;
+
+    int Begin();
+    int Open();
+    void Fail();
+    void ApplyTiming();
+    int Finish(int err, unsigned long long startUs);
+    bool Recover();
+};
+
+
+// Builds a multi-message I2C_RDWR transfer so a command and the read
+// that confirms it go out as one ioctl, joined by repeated starts.
+#define I2C_MAX_MSGS	4
+
+class CI2CTransaction
+{
+public:
+    CI2CTransaction(__u16 address);
+
+    CI2CTransaction &WriteByte(__u8 command, __u8 value);
+    CI2CTransaction &WriteWord(__u8 command, __u16 value);
+    CI2CTransaction &Read(__u8 command, __u8 *buffer, int buflen);
+
+    int Execute(CI2CTransport &transport);
+
+private:
+    __u16 m_address;
+    int m_count;
+    int m_overflow;
+
+    struct i2c_msg m_msgs[I2C_MAX_MSGS];
+    __u8 m_out[I2C_MAX_MSGS][3];
+
+    bool Reserve(int nmsgs);
+    void Add(__u16 flags, __u8 *buf, int len);
+};
+
+
+#endif
@@ -0,0 +1,68 @@
+
+#include <linux/types.h>
+#include <linux/i2c.h>
+
+
+#ifndef __I2C_TRANSPORT_H
+#define __I2C_TRANSPORT_H
+
+// Running totals for a bus transport.  lastSyscalls is the number of
+// open/ioctl/close calls made by the most recent transaction, so a
+// healthy poll should read 1.  Overruns are transactions that took
+// longer than the watchdog deadline; a failed one triggers a bus
+// recovery.
+typedef struct _i2c_stats {
+    unsigned long transactions;
+    unsigned long syscalls;
+    unsigned long opens;
+    unsigned long errors;
+    unsigned int  lastSyscalls;
+    unsigned long overruns;
+    unsigned long recoveries;
+    unsigned long failedRecoveries;
+    // Wall time of the slowest transaction, in microseconds
+    unsigned long long maxUs;
+    // The most recent overrun could not be recovered from
+    bool stuck;
+    // I2C_TIMEOUT or I2C_RETRIES calls the adapter refused
+    unsigned long timingErrors;
+} I2C_STATS;
+
+// Adapter timeout and retries, set on the bus with I2C_TIMEOUT and
+// I2C_RETRIES, and the wall time after which the watchdog counts a
+// transaction as overrun.  The timeout and retries belong to the
+// adapter, so sessions sharing a bus share them and the last one set
+// wins; the deadline is per session.
+typedef struct _i2c_timing {
+    unsigned int timeoutMs;
+    unsigned int retries;
+    unsigned int deadlineMs;
+} I2C_TIMING;
+
+// Error for a transaction that failed after overrunning its deadline
+#define I2C_ERR_DEADLINE	800
+
+
+// What CFusionFocusDriver needs from the bus.  CI2CSession talks to the
+// kernel; CFusionSimulator stands in for a Fusion board.
+class CI2CTransport
+{
+public:
+    virtual ~CI2CTransport() {}
+
+    // All calls return 0 on success or a CFocusException error code.
+    virtual int SmbusAccess(char read_write, __u8 command, int size, union i2c_smbus_data *data) = 0;
+    virtual int Transfer(struct i2c_msg *msgs, int nmsgs) = 0;
+
+    virtual void Close() = 0;
+
+    // Safe to call from another thread; takes effect from the next
+    // transaction.  Transports without a real bus ignore it.
+    virtual void SetTiming(const I2C_TIMING &) {}
+
+    virtual __u16 Address() const = 0;
+    virtual const I2C_STATS &Stats() const = 0;
+};
+
+
+#endif
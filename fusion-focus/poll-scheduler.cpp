@@ -0,0 +1,61 @@
+#include "poll-scheduler.h"
+#include "monotonic-clock.h"
+
+#define DEFAULT_FAST_MS		100
+#define DEFAULT_SETTLE_MS	2000
+#define DEFAULT_IDLE_MIN_MS	1000
+#define DEFAULT_IDLE_MAX_MS	8000
+
+CPollScheduler::CPollScheduler()
+{
+	m_fastMs = DEFAULT_FAST_MS;
+	m_settleMs = DEFAULT_SETTLE_MS;
+	m_idleMinMs = DEFAULT_IDLE_MIN_MS;
+	m_idleMaxMs = DEFAULT_IDLE_MAX_MS;
+
+	m_current = 0;
+	m_lastMotion = 0;
+}
+
+void CPollScheduler::SetRates(unsigned int fastMs, unsigned int settleMs, unsigned int idleMinMs, unsigned int idleMaxMs)
+{
+	m_fastMs = fastMs;
+	m_settleMs = settleMs;
+	m_idleMinMs = idleMinMs < fastMs ? fastMs : idleMinMs;
+	m_idleMaxMs = idleMaxMs < m_idleMinMs ? m_idleMinMs : idleMaxMs;
+}
+
+void CPollScheduler::Moved()
+{
+	m_lastMotion = MonotonicMs();
+	m_current = m_fastMs;
+}
+
+unsigned int CPollScheduler::Next(bool moving)
+{
+	unsigned long long now = MonotonicMs();
+
+	if (moving)
+	{
+		m_lastMotion = now;
+		m_current = m_fastMs;
+	}
+	else if (m_lastMotion != 0 && now - m_lastMotion < m_settleMs)
+	{
+		m_current = m_fastMs;
+	}
+	else if (m_current < m_idleMinMs)
+	{
+		m_current = m_idleMinMs;
+	}
+	else
+	{
+		m_current *= 2;
+		if (m_current > m_idleMaxMs)
+		{
+			m_current = m_idleMaxMs;
+		}
+	}
+
+	return m_current;
+}
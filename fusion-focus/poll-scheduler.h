@@ -0,0 +1,33 @@
+
+#ifndef __POLL_SCHEDULER_H
+#define __POLL_SCHEDULER_H
+
+// Chooses the interval to the next status poll.  Polls fast while the
+// focuser is moving and for a settle window after it stops, then backs
+// off exponentially from the idle minimum to the idle maximum.
+class CPollScheduler
+{
+public:
+    CPollScheduler();
+
+    void SetRates(unsigned int fastMs, unsigned int settleMs, unsigned int idleMinMs, unsigned int idleMaxMs);
+
+    // A move has been commanded; poll fast from now on.
+    void Moved();
+
+    // Interval in ms until the next poll, given the latest status.
+    unsigned int Next(bool moving);
+
+    unsigned int Current() const { return m_current; }
+
+private:
+    unsigned int m_fastMs;
+    unsigned int m_settleMs;
+    unsigned int m_idleMinMs;
+    unsigned int m_idleMaxMs;
+
+    unsigned int m_current;
+    unsigned long long m_lastMotion;
+};
+
+#endif
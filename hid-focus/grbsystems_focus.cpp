@@ -16,35 +16,130 @@
 */
 
 #include "grbsystems_focus.h"
+#include "hid_simulator.h"
+#include "hid_reader.h"
+#include "monotonic-clock.h"
 #include <memory>
+#include <vector>
 #include <string.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 #define POLL_MS  1000
 #define MAX_STR 255
 #define BUF_SIZE 64
-
-std::unique_ptr<GRBSystems> grbSystems(new GRBSystems());
+#define MOVE_ACK_TIMEOUT_MS 100
+#define PREFS_DEBOUNCE_MS 20
+// A failed preferences write is tried again after this
+#define PREFS_RETRY_MS 1000
+
+// Preference fields changed locally since the last 0x2A write
+#define PREF_MAXIMUM    0x01
+#define PREF_PULSE      0x02
+#define PREF_DIRECTION  0x04
+#define PREF_BACKLASH   0x08
+
+#define STATS_TAB "Statistics"
+#define STATS_PERIOD_MS 10000
+// Alert when an abort takes longer than this to reach the bus
+#define ABORT_ALARM_MS 50
+
+#define SWEEP_TAB "Sweep"
+
+#define MAX_DEVICES 8
+#define TELEMETRY_LOG_BYTES (16 * 1024 * 1024)
+
+// REPORT fields in the order HandleReport logs them
+static const char *const telemetryFields[] = {
+    "moving", "position", "maximum", "pulse", "direction", "backlash", "microns"
+};
+
+// One device per controller.  INDI_GRBSYSTEMS_FOCUSERS sets how many
+// this process hosts; each picks its controller by serial number.
+std::vector<std::unique_ptr<GRBSystems>> grbDevices;
+
+// Reports whose bus traffic is published on the statistics tab
+static const BUS_OPCODE busOpcodes[] = {
+    { 0x11, "MOVE_ABS", "Move Abs" },
+    { 0x13, "STOP", "Stop" },
+    { 0x16, "SET_POINT", "Set Point" },
+    { 0x2A, "UPDATE_PREFS", "Update Prefs" },
+    { HID_INPUT_REPORT, "INPUT_REPORT", "Input Report" },
+    { 0, NULL, NULL }
+};
 static int times[5] = {15, 5, 3, 1, 0};
 
+static void CreateDevices()
+{
+    if(!grbDevices.empty()){
+        return;
+    }
+
+    const char *env = getenv("INDI_GRBSYSTEMS_FOCUSERS");
+    int count = env != NULL ? atoi(env) : 1;
+    if(count < 1){
+        count = 1;
+    } else if(count > MAX_DEVICES){
+        count = MAX_DEVICES;
+    }
+
+    for(int i = 0; i < count; i++){
+        GRBSystems *focus = new GRBSystems();
+
+        // The first keeps the default name so existing configs still apply
+        if(i > 0){
+            char name[MAXINDINAME];
+            snprintf(name, sizeof(name), "%s %d", focus->getDefaultName(), i + 1);
+            focus->setDeviceName(name);
+        }
+
+        grbDevices.push_back(std::unique_ptr<GRBSystems>(focus));
+    }
+}
+
+static bool IsDevice(const char *dev, GRBSystems *focus)
+{
+    return dev == NULL || !strcmp(dev, focus->getDeviceName());
+}
+
 void ISGetProperties(const char *dev)
 {
-    grbSystems->ISGetProperties(dev);
+    CreateDevices();
+    for(size_t i = 0; i < grbDevices.size(); i++){
+        if(IsDevice(dev, grbDevices[i].get())){
+            grbDevices[i]->ISGetProperties(dev);
+        }
+    }
 }
 
 void ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int num)
 {
-    grbSystems->ISNewSwitch(dev, name, states, names, num);
+    CreateDevices();
+    for(size_t i = 0; i < grbDevices.size(); i++){
+        if(IsDevice(dev, grbDevices[i].get())){
+            grbDevices[i]->ISNewSwitch(dev, name, states, names, num);
+        }
+    }
 }
 
 void ISNewText(	const char *dev, const char *name, char *texts[], char *names[], int num)
 {
-    grbSystems->ISNewText(dev, name, texts, names, num);
+    CreateDevices();
+    for(size_t i = 0; i < grbDevices.size(); i++){
+        if(IsDevice(dev, grbDevices[i].get())){
+            grbDevices[i]->ISNewText(dev, name, texts, names, num);
+        }
+    }
 }
 
 void ISNewNumber(const char *dev, const char *name, double values[], char *names[], int num)
 {
-    grbSystems->ISNewNumber(dev, name, values, names, num);
+    CreateDevices();
+    for(size_t i = 0; i < grbDevices.size(); i++){
+        if(IsDevice(dev, grbDevices[i].get())){
+            grbDevices[i]->ISNewNumber(dev, name, values, names, num);
+        }
+    }
 }
 
 void ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[], char *names[], int n)
@@ -61,7 +156,10 @@ void ISNewBLOB (const char *dev, const char *name, int sizes[], int blobsizes[],
 
 void ISSnoopDevice (XMLEle *root)
 {
-    grbSystems->ISSnoopDevice(root);
+    CreateDevices();
+    for(size_t i = 0; i < grbDevices.size(); i++){
+        grbDevices[i]->ISSnoopDevice(root);
+    }
 }
 
 GRBSystems::GRBSystems()
@@ -70,15 +168,45 @@ GRBSystems::GRBSystems()
     setSupportedConnections(CONNECTION_NONE);
 
     // Can move in Absolute & Relative motions, can AbortFocuser motion, and has variable speed.        
-    FI::SetCapability(FOCUSER_CAN_ABS_MOVE | FOCUSER_CAN_ABORT | FOCUSER_CAN_REVERSE|
+    FI::SetCapability(FOCUSER_CAN_ABS_MOVE | FOCUSER_CAN_REL_MOVE | FOCUSER_CAN_ABORT | FOCUSER_CAN_REVERSE|
                            FOCUSER_CAN_SYNC | FOCUSER_HAS_VARIABLE_SPEED | FOCUSER_HAS_BACKLASH);
 
     haveReport = false;
+    readerLost = false;
+    wakeFailures = 0;
+    lostLogged = false;
+    wakeFailuresLogged = 0;
+
+    transport = NULL;
 
-    handle = NULL;
-    timerid = -1;
+    reportFd = -1;
+    reportCallback = -1;
+    lastStatsMs = 0;
+    statsTimer = -1;
 
     targetPos = -1;
+    moveCount = 0;
+
+    lastReportSeq = 0;
+    lastTargetPos = -1;
+    moveReportSeq = 0;
+
+    moveInFlight = false;
+    moveTimer = -1;
+    requestedPosition = 0;
+
+    sweepTimer = -1;
+
+    memset(&prefs, 0, sizeof(prefs));
+    prefsValid = false;
+    prefsOwned = 0;
+    prefsDirty = 0;
+    prefsFailed = 0;
+    prefsTimer = -1;
+    prefsRequested = 0;
+    prefsWritten = 0;
+
+    busState = CRetryPolicy::CLOSED;
 }
 
 GRBSystems::~GRBSystems()
@@ -86,44 +214,121 @@ GRBSystems::~GRBSystems()
 
 }
 
+CHidTransport *GRBSystems::CreateTransport()
+{
+    const char *path = CaptureFileT[0].text;
+    int mode = IUFindOnSwitchIndex(&TransportModeSP);
+
+    if(isSimulation()){
+        DEBUG(INDI::Logger::DBG_SESSION, "Using simulated GRBSystems firmware");
+        return new CHidInstrumented(new CHidSimulator(), busStats);
+    }
+
+    if(mode == TRANSPORT_REPLAY){
+        DEBUGF(INDI::Logger::DBG_SESSION, "Replaying HID traffic from %s at %.1fx", path, ReplaySpeedN[0].value);
+        return new CHidInstrumented(new CHidReplay(path, ReplaySpeedN[0].value), busStats);
+    }
+
+    if(SerialT[0].text[0] != 0){
+        DEBUGF(INDI::Logger::DBG_SESSION, "Looking for controller with serial %s", SerialT[0].text);
+    }
+
+    CHidTransport *device;
+    if(IUFindOnSwitchIndex(&BackendSP) == BACKEND_HIDAPI){
+        device = new CHidApiTransport(SerialT[0].text);
+    } else {
+        device = new CHidRawTransport(SerialT[0].text);
+    }
+
+    // Timed underneath the recorder so capture file writes are not counted
+    CHidTransport *live = new CHidInstrumented(device, busStats);
+
+    if(mode == TRANSPORT_RECORD){
+        DEBUGF(INDI::Logger::DBG_SESSION, "Recording HID traffic to %s", path);
+        return new CHidRecorder(live, path);
+    }
+
+    return live;
+}
+
 bool GRBSystems::Connect(){
-    int res;
-    wchar_t wstr[MAX_STR+1];
     char cstr[MAX_STR+1];
 
-    // Open the device using the VID, PID,
-    // and optionally the Serial number.
-    handle = hid_open(0x4d8, 0x3f, NULL);
+    busStats.Reset();
+    writePolicy.Reset();
+    abortLatencyProperty.Reset();
+    busState = CRetryPolicy::CLOSED;
+    transport = CreateTransport();
 
-    if(handle != NULL) {
+    if(transport->Open()) {
         // Read the Manufacturer String
-        res = hid_get_manufacturer_string(handle, wstr, MAX_STR);
-        if(res == 0){
-            wcstombs(cstr, wstr, MAX_STR);
+        if(transport->GetManufacturer(cstr, sizeof(cstr))){
             IDMessage(getDeviceName(), "Manufacturer: %s", cstr);
         }
 
         // Read the Product String
-        res = hid_get_product_string(handle, wstr, MAX_STR);
-        if(res == 0){
-            wcstombs(cstr, wstr, MAX_STR);
+        if(transport->GetProduct(cstr, sizeof(cstr))){
             IDMessage(getDeviceName(), "Product: %s", cstr);
         }
 
         IDMessage(getDeviceName(), "GRBSystems focuser connected sucessfully!");
 
-        timerid = SetTimer(POLL_MS);
+        propertyShadow.Reset();
+        lastReportSeq = 0;
+        moveInFlight = false;
+        moves.ResetCounts();
+        motion.Stop();
+
+        prefsValid = false;
+        prefsOwned = 0;
+        prefsDirty = 0;
+        prefsFailed = 0;
+        prefsRequested = 0;
+        prefsWritten = 0;
+
+        // The reader thread signals this whenever the device state changes
+        reportFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(reportFd < 0){
+            IDMessage(getDeviceName(), "Error creating report event");
+            delete transport;
+            transport = NULL;
+            return false;
+        }
+
+        reportCallback = IEAddCallback(reportFd, ReportReady, this);
+
+        // Bus statistics are sent even while no reports are getting through
+        statsTimer = SetTimer(STATS_PERIOD_MS);
+
+        telemetryProperty.Open(TELEMETRY_LOG_BYTES, telemetryFields, sizeof(telemetryFields) / sizeof(telemetryFields[0]));
 
-        // Start the reader thread
-        keep_running = true;
-        if(pthread_create(&reader_thread, NULL, Reader, this)){
-            IDMessage(getDeviceName(), "Error creating reader thread");
+        // Input reports arrive on the reader shared by every controller
+        readerLost = false;
+        lostLogged = false;
+        wakeFailuresLogged = wakeFailures;
+        readerFirst = true;
+        readerMoves = moveCount;
+        if(!CHidReader::Instance().Add(transport, ReportReceived, this)){
+            IDMessage(getDeviceName(), "Error adding the controller to the report reader");
+            Disconnect();
             return false;
         }
 
         return true;
     }
 
+    delete transport;
+    transport = NULL;
+
+    if(IUFindOnSwitchIndex(&TransportModeSP) != TRANSPORT_REPLAY && !isSimulation()){
+        if(IUFindOnSwitchIndex(&BackendSP) == BACKEND_HIDAPI){
+            CHidApiTransport::List(cstr, sizeof(cstr));
+        } else {
+            CHidRawTransport::List(cstr, sizeof(cstr));
+        }
+        DEBUGF(INDI::Logger::DBG_SESSION, "Controllers found: %s", cstr[0] ? cstr : "none");
+    }
+
     IDMessage(getDeviceName(), "GRBSystems cannot connect!");
 
     return false;
@@ -131,21 +336,58 @@ bool GRBSystems::Connect(){
 
 bool GRBSystems::Disconnect(){
 
-    keep_running = false;
-    pthread_join(reader_thread, NULL);
+    if(sweep.Active()){
+        EndSweep(IPS_IDLE);
+    }
 
-    if(handle != NULL){
-        hid_close(handle);
+    if(transport != NULL){
+        CHidReader::Instance().Remove(transport);
+        haveReport = false;
 
-        handle = NULL;
+        transport->Close();
+        delete transport;
+
+        transport = NULL;
     }
 
+    telemetryProperty.Close();
+
     IDMessage(getDeviceName(), "GRBSystems Focuser disconnected successfully!");
 
-    if(timerid != -1){
-        RemoveTimer(timerid);
-        timerid = -1;
+    if(reportCallback != -1){
+        IERmCallback(reportCallback);
+        reportCallback = -1;
+    }
+
+    if(statsTimer != -1){
+        RemoveTimer(statsTimer);
+        statsTimer = -1;
+    }
+
+    if(moveTimer != -1){
+        IERmTimer(moveTimer);
+        moveTimer = -1;
+    }
+
+    moves.Cancel();
+
+    estimateProperty.Stop();
+
+    if(prefsTimer != -1){
+        IERmTimer(prefsTimer);
+        prefsTimer = -1;
+    }
+
+    if(prefsDirty != 0){
+        DEBUG(INDI::Logger::DBG_WARNING, "Unsent preference changes discarded");
+        prefsDirty = 0;
+    }
+
+    if(reportFd != -1){
+        close(reportFd);
+        reportFd = -1;
     }
+
     return true;
 }
 
@@ -168,7 +410,50 @@ bool GRBSystems::initProperties()
     FocusBacklashN[0].value = 0;
     FocusBacklashN[0].step = 5;
 
+    IUFillNumber(&PublishStatsN[0], "EMITTED", "Emitted", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&PublishStatsN[1], "SUPPRESSED", "Suppressed", "%.f", 0., 0., 0., 0.);
+    IUFillNumberVector(&PublishStatsNP, PublishStatsN, 2, getDeviceName(), "PUBLISH_STATS", "Updates", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    IUFillNumber(&MoveStatsN[0], "REQUESTED", "Requested", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MoveStatsN[1], "SENT", "Sent", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&MoveStatsN[2], "COALESCED", "Coalesced", "%.f", 0., 0., 0., 0.);
+    IUFillNumberVector(&MoveStatsNP, MoveStatsN, 3, getDeviceName(), "MOVE_STATS", "Moves", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    IUFillNumber(&PrefsStatsN[0], "REQUESTED", "Requested", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&PrefsStatsN[1], "WRITTEN", "Written", "%.f", 0., 0., 0., 0.);
+    IUFillNumber(&PrefsStatsN[2], "SAVED", "Saved", "%.f", 0., 0., 0., 0.);
+    IUFillNumberVector(&PrefsStatsNP, PrefsStatsN, 3, getDeviceName(), "PREFS_STATS", "Preference Writes", STATS_TAB, IP_RO, 0, IPS_IDLE);
+
+    sweepProperty.Fill(getDeviceName(), SWEEP_TAB);
+
+    estimateProperty.Fill(getDeviceName(), MAIN_CONTROL_TAB, propertyShadow, MotionState, this);
+
+    busStatsProperty.Fill(getDeviceName(), STATS_TAB, busOpcodes);
+    busHealthProperty.Fill(getDeviceName(), STATS_TAB);
+    abortLatencyProperty.Fill(getDeviceName(), STATS_TAB, ABORT_ALARM_MS);
+
+    IUFillSwitch(&TransportModeS[TRANSPORT_LIVE], "LIVE", "Live", ISS_ON);
+    IUFillSwitch(&TransportModeS[TRANSPORT_RECORD], "RECORD", "Record", ISS_OFF);
+    IUFillSwitch(&TransportModeS[TRANSPORT_REPLAY], "REPLAY", "Replay", ISS_OFF);
+    IUFillSwitchVector(&TransportModeSP, TransportModeS, 3, getDeviceName(), "HID_TRANSPORT", "HID Traffic", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    IUFillSwitch(&BackendS[BACKEND_HIDRAW], "HIDRAW", "hidraw", ISS_ON);
+    IUFillSwitch(&BackendS[BACKEND_HIDAPI], "HIDAPI", "hidapi", ISS_OFF);
+    IUFillSwitchVector(&BackendSP, BackendS, 2, getDeviceName(), "HID_BACKEND", "HID Backend", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    IUFillText(&CaptureFileT[0], "FILE", "File", "/tmp/grbsystems.hidcap");
+    IUFillTextVector(&CaptureFileTP, CaptureFileT, 1, getDeviceName(), "HID_CAPTURE", "Capture", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    IUFillText(&SerialT[0], "SERIAL", "Serial (blank = any)", "");
+    IUFillTextVector(&SerialTP, SerialT, 1, getDeviceName(), "HID_SERIAL", "Controller", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
+    telemetryProperty.Fill(getDeviceName(), OPTIONS_TAB);
+
+    IUFillNumber(&ReplaySpeedN[0], "SPEED", "Speed (x, 0 = max)", "%.1f", 0., 100., 1., 1.);
+    IUFillNumberVector(&ReplaySpeedNP, ReplaySpeedN, 1, getDeviceName(), "HID_REPLAY", "Replay", OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
     addDebugControl();
+    addSimulationControl();
 
     setDefaultPollingPeriod(POLL_MS);
 
@@ -182,12 +467,107 @@ bool GRBSystems::initProperties()
 
 }
 
+// The traffic options pick the transport at connect time, so they are
+// available before connecting.
+void GRBSystems::ISGetProperties(const char *dev)
+{
+    INDI::Focuser::ISGetProperties(dev);
+
+    defineText(&SerialTP);
+    defineSwitch(&TransportModeSP);
+    defineSwitch(&BackendSP);
+    defineText(&CaptureFileTP);
+    defineNumber(&ReplaySpeedNP);
+    telemetryProperty.Define(this);
+
+    loadConfig(true, SerialTP.name);
+    loadConfig(true, TransportModeSP.name);
+    loadConfig(true, BackendSP.name);
+    loadConfig(true, CaptureFileTP.name);
+    loadConfig(true, ReplaySpeedNP.name);
+    loadConfig(true, telemetryProperty.Name());
+}
+
+bool GRBSystems::saveConfigItems(FILE *fp)
+{
+    INDI::Focuser::saveConfigItems(fp);
+
+    IUSaveConfigText(fp, &SerialTP);
+    IUSaveConfigSwitch(fp, &TransportModeSP);
+    IUSaveConfigSwitch(fp, &BackendSP);
+    IUSaveConfigText(fp, &CaptureFileTP);
+    IUSaveConfigNumber(fp, &ReplaySpeedNP);
+    telemetryProperty.Save(fp);
+    sweepProperty.Save(fp);
+
+    return true;
+}
+
+bool GRBSystems::ISNewText (const char *dev, const char *name, char *texts[], char *names[], int n)
+{
+    if(strcmp(dev,getDeviceName())==0)
+    {
+        if (!strcmp (name, CaptureFileTP.name)) {
+            IUUpdateText(&CaptureFileTP, texts, names, n);
+            CaptureFileTP.s = IPS_OK;
+            IDSetText(&CaptureFileTP, NULL);
+
+            return true;
+        }
+
+        REPORT current;
+        report.Load(current);
+
+        // New positions replace a sweep still running.  It ends here,
+        // whether or not the new list can be planned.
+        if (sweep.Active() && !strcmp (name, sweepProperty.PositionsName())) {
+            EndSweep(IPS_ALERT);
+        }
+
+        bool started;
+        if (sweepProperty.ISNewText(name, texts, names, n, sweep, current.position, current.maximum, started)) {
+            if (started) {
+                SweepStep();
+            }
+
+            return true;
+        }
+
+        if (telemetryProperty.ISNewText(name, texts, names, n, isConnected())) {
+            return true;
+        }
+
+        if (!strcmp (name, SerialTP.name)) {
+            IUUpdateText(&SerialTP, texts, names, n);
+            SerialTP.s = IPS_OK;
+            IDSetText(&SerialTP, NULL);
+
+            if (isConnected()) {
+                DEBUG(INDI::Logger::DBG_SESSION, "Controller serial takes effect on the next connect");
+            }
+
+            return true;
+        }
+    }
+
+    return INDI::Focuser::ISNewText(dev, name, texts, names, n);
+}
+
 bool GRBSystems::updateProperties()
 {
     INDI::Focuser::updateProperties();
 
     if (isConnected())
     {
+        estimateProperty.Define(this);
+        defineNumber(&PublishStatsNP);
+        defineNumber(&MoveStatsNP);
+        defineNumber(&PrefsStatsNP);
+        sweepProperty.Define(this);
+        busStatsProperty.Define(this);
+        busHealthProperty.Define(this);
+        abortLatencyProperty.Define(this);
+
         GetFocusParams();
 
         loadConfig(true);
@@ -196,6 +576,14 @@ bool GRBSystems::updateProperties()
     }
     else
     {
+        estimateProperty.Delete(this);
+        deleteProperty(PublishStatsNP.name);
+        deleteProperty(MoveStatsNP.name);
+        deleteProperty(PrefsStatsNP.name);
+        sweepProperty.Delete(this);
+        busStatsProperty.Delete(this);
+        busHealthProperty.Delete(this);
+        abortLatencyProperty.Delete(this);
     }
 
     return true;
@@ -232,12 +620,46 @@ bool GRBSystems::MoveFocuser(unsigned int position)
         return false;
     }
 
-    if(handle == NULL){
-        DEBUGF(INDI::Logger::DBG_ERROR, "handle is NULL! This shouldn't happen!", NULL);
+    if(transport == NULL){
+        DEBUGF(INDI::Logger::DBG_ERROR, "transport is NULL! This shouldn't happen!", NULL);
         return false;
     }
 
+    requestedPosition = position;
+
+    // Latest target wins.  An unsent one is simply replaced, and while
+    // the last move has not shown up in a report the new one is held.
+    if(!moves.Offer(position)){
+        return true;
+    }
+
+    if(moveInFlight){
+        if(moveTimer == -1){
+            moveTimer = IEAddTimer(MOVE_ACK_TIMEOUT_MS, MoveTimeout, this);
+        }
+
+        return true;
+    }
+
+    return SendMove();
+}
+
+bool GRBSystems::SendMove()
+{
+    unsigned int position;
+    if(!moves.Take(position)){
+        return true;
+    }
+
+    if(moveTimer != -1){
+        IERmTimer(moveTimer);
+        moveTimer = -1;
+    }
+
     targetPos = position;
+    moveInFlight = true;
+    moveReportSeq = report.Sequence();
+    moveCount++;
 
     // Build out the HID report for a move absolute
     unsigned char buf[BUF_SIZE];
@@ -252,31 +674,25 @@ bool GRBSystems::MoveFocuser(unsigned int position)
 
 
     int res;
-    res = hid_write(handle, buf, BUF_SIZE);
+    res = WriteReport(buf);
     if(res != BUF_SIZE){
         DEBUGF(INDI::Logger::DBG_ERROR, "Failed to write move buffer: %d bytes sent", res);
         return false;
     }
 
-    report.isMoving = true;
-
     return true;
 }
 
 bool GRBSystems::UpdateMaxTravel(unsigned int position) {
-    REPORT newRep = report;
-
-    newRep.maximum = position;
+    prefs.maximum = position;
 
-    return UpdatePrefs(&newRep);
+    return UpdatePrefs(PREF_MAXIMUM);
 }
 
 bool GRBSystems::UpdateBacklash(unsigned int backlash) {
-    REPORT newRep = report;
+    prefs.backlash = backlash;
 
-    newRep.backlash = backlash;
-
-    return UpdatePrefs(&newRep);
+    return UpdatePrefs(PREF_BACKLASH);
 }
 
 bool GRBSystems::UpdateCurPos(unsigned int position) {
@@ -292,7 +708,7 @@ bool GRBSystems::UpdateCurPos(unsigned int position) {
     buf[4] = bottom;
 
     int res;
-    res = hid_write(handle, buf, BUF_SIZE);
+    res = WriteReport(buf);
     if(res != BUF_SIZE){
         DEBUGF(INDI::Logger::DBG_ERROR, "Failed to write curpos buffer: %d bytes sent", res);
         return false;
@@ -303,66 +719,196 @@ bool GRBSystems::UpdateCurPos(unsigned int position) {
 
 bool GRBSystems::UpdateSpeed(unsigned int speed) {
     // These delay to delay factors in the firmware.
-    REPORT newRep = report;
-
     if(speed > 5)
     {
         speed = 5;
     }
 
-    newRep.pulse = times[speed-1];
-    return UpdatePrefs(&newRep);
+    prefs.pulse = times[speed-1];
+    return UpdatePrefs(PREF_PULSE);
 }
 
 bool GRBSystems::UpdateDirection(bool outPositive) {
-    REPORT newRep = report;
+    prefs.direction = outPositive ? 0 : 1;
+
+    return UpdatePrefs(PREF_DIRECTION);
+}
+
+// Changes are collected in prefs and sent as one 0x2A report once none
+// has arrived for PREFS_DEBOUNCE_MS.  Loading a config on connect sets
+// several preferences back to back, and each write carries all of them.
+bool GRBSystems::UpdatePrefs(int fields)
+{
+    if(transport == NULL){
+        DEBUG(INDI::Logger::DBG_ERROR, "Not Connected!");
+        return false;
+    }
+
+    prefsOwned |= fields;
+    prefsDirty |= fields;
+    prefsRequested++;
 
-    newRep.direction = outPositive ? 0 : 1;
+    if(prefsTimer != -1){
+        IERmTimer(prefsTimer);
+    }
+
+    prefsTimer = IEAddTimer(PREFS_DEBOUNCE_MS, PrefsTimeout, this);
+
+    return true;
+}
+
+void GRBSystems::PrefsTimeout(void *p)
+{
+    GRBSystems* sys = (GRBSystems*)p;
+
+    sys->prefsTimer = -1;
+    sys->WritePrefs();
+}
+
+// Only fields never set by this session are taken from the device, so a
+// write is never built from a report that predates an earlier write.
+void GRBSystems::MergePrefs(const REPORT &current)
+{
+    if(!(prefsOwned & PREF_MAXIMUM))   prefs.maximum = current.maximum;
+    if(!(prefsOwned & PREF_PULSE))     prefs.pulse = current.pulse;
+    if(!(prefsOwned & PREF_DIRECTION)) prefs.direction = current.direction;
+    if(!(prefsOwned & PREF_BACKLASH))  prefs.backlash = current.backlash;
+    prefs.microns = current.microns;
 
-    return UpdatePrefs(&newRep);
+    prefsValid = true;
 }
 
-bool GRBSystems::UpdatePrefs(REPORT *prefs)
+bool GRBSystems::WritePrefs()
 {
+    if(prefsDirty == 0 || transport == NULL){
+        return true;
+    }
+
+    // The fields we do not set have to come from the device first
+    if(!prefsValid){
+        REPORT current;
+        if(report.Load(current) == 0){
+            prefsTimer = IEAddTimer(PREFS_DEBOUNCE_MS, PrefsTimeout, this);
+            return true;
+        }
+
+        MergePrefs(current);
+    }
+
     // Build out the HID report for a move absolute
     unsigned char buf[BUF_SIZE];
+    memset(buf, 0, sizeof(buf));
 
     buf[0] = 0x00;      // Header byte
     buf[1] = 0x2A;      // Update Prefs
     buf[2] = 0x00;      // channel 0
 
     // Setting Max
-    buf[3] = ((prefs->maximum & 0xff00) >> 8);
-    buf[4] = (prefs->maximum & 0x00ff);
+    buf[3] = ((prefs.maximum & 0xff00) >> 8);
+    buf[4] = (prefs.maximum & 0x00ff);
 
     // Set pulse
-    buf[5] = prefs->pulse;
+    buf[5] = prefs.pulse;
 
     // Set Direction
-    buf[6] = prefs->direction;
+    buf[6] = prefs.direction;
 
     // Set Backlash
-    buf[7] = ((prefs->backlash & 0xff00) >> 8);
-    buf[8] = (prefs->backlash & 0x00ff);
+    buf[7] = ((prefs.backlash & 0xff00) >> 8);
+    buf[8] = (prefs.backlash & 0x00ff);
 
     // Set Microns (int scaled by 100)
-    buf[9] = ((prefs->microns & 0xff00) >> 8);
-    buf[10] = (prefs->microns & 0x00ff);
+    buf[9] = ((prefs.microns & 0xff00) >> 8);
+    buf[10] = (prefs.microns & 0x00ff);
 
     int res;
-    res = hid_write(handle, buf, BUF_SIZE);
+    res = WriteReport(buf);
     if(res != BUF_SIZE){
-        DEBUGF(INDI::Logger::DBG_ERROR, "Failed to write preferences: %d bytes sent", res);
+        // Keep the changes and try again; only the first failure is
+        // worth an error while the controller stays unreachable.
+        if(prefsFailed == 0){
+            DEBUGF(INDI::Logger::DBG_ERROR, "Failed to write preferences: %d bytes sent, retrying", res);
+        }
+
+        prefsFailed |= prefsDirty;
+        SetPrefsState(prefsDirty, IPS_ALERT);
+        prefsTimer = IEAddTimer(PREFS_RETRY_MS, PrefsTimeout, this);
         return false;
     }
 
+    if(prefsFailed != 0){
+        DEBUG(INDI::Logger::DBG_SESSION, "Preferences written after retrying");
+        SetPrefsState(prefsFailed, IPS_OK);
+        prefsFailed = 0;
+    }
+
+    prefsDirty = 0;
+    prefsWritten++;
+
     return true;
 }
 
+// The client properties behind a set of preference fields
+void GRBSystems::SetPrefsState(int fields, IPState state)
+{
+    if(fields & PREF_MAXIMUM){
+        FocusMaxPosNP.s = state;
+        IDSetNumber(&FocusMaxPosNP, NULL);
+    }
+
+    if(fields & PREF_PULSE){
+        FocusSpeedNP.s = state;
+        IDSetNumber(&FocusSpeedNP, NULL);
+    }
+
+    if(fields & PREF_DIRECTION){
+        FocusReverseSP.s = state;
+        IDSetSwitch(&FocusReverseSP, NULL);
+    }
+
+    if(fields & PREF_BACKLASH){
+        FocusBacklashNP.s = state;
+        IDSetNumber(&FocusBacklashNP, NULL);
+    }
+}
+
+
+// Every report goes out through the retry policy, so writes to a
+// controller that has gone away back off instead of failing back to
+// back.  Returns what the last attempt wrote, -1 if none was allowed.
+// An urgent report is written even while the breaker is open.
+int GRBSystems::WriteReport(unsigned char *buf, bool urgent)
+{
+    int res = -1;
+    bool ok;
+
+    writePolicy.Run([&]() -> bool
+    {
+        res = transport->Write(buf, BUF_SIZE);
+        return res == BUF_SIZE;
+    }, ok, urgent);
+
+    int state = writePolicy.State();
+    if(state != busState){
+        if(state == CRetryPolicy::OPEN && busState == CRetryPolicy::CLOSED){
+            DEBUG(INDI::Logger::DBG_ERROR, "GRBSystems not accepting reports, backing off");
+        } else if(state == CRetryPolicy::CLOSED){
+            DEBUG(INDI::Logger::DBG_SESSION, "GRBSystems accepting reports again");
+        }
+
+        busState = state;
+        busHealthProperty.Publish(writePolicy, true);
+    }
+
+    return res;
+}
 
 bool GRBSystems::ISNewSwitch (const char *dev, const char *name, ISState *states, char *names[], int n)
 {
     if(strcmp(dev,getDeviceName())==0) {
+        // The client is about to be sent this property directly
+        propertyShadow.Invalidate(name);
+
         if (strcmp(name, "FOCUS_REVERSE_MOTION") == 0) {
             //  client is telling us what to do with focus direction
             FocusReverseSP.s = IPS_OK;
@@ -384,6 +930,34 @@ bool GRBSystems::ISNewSwitch (const char *dev, const char *name, ISState *states
             AbortFocuser();
         }
 
+        if (sweepProperty.ISNewSwitch(name, states, names, n)) {
+            return true;
+        }
+
+        if (!strcmp (name, TransportModeSP.name)) {
+            IUUpdateSwitch(&TransportModeSP, states, names, n);
+            TransportModeSP.s = IPS_OK;
+            IDSetSwitch(&TransportModeSP, NULL);
+
+            if (isConnected()) {
+                DEBUG(INDI::Logger::DBG_SESSION, "HID traffic mode takes effect on the next connect");
+            }
+
+            return true;
+        }
+
+        if (!strcmp (name, BackendSP.name)) {
+            IUUpdateSwitch(&BackendSP, states, names, n);
+            BackendSP.s = IPS_OK;
+            IDSetSwitch(&BackendSP, NULL);
+
+            if (isConnected()) {
+                DEBUG(INDI::Logger::DBG_SESSION, "HID backend takes effect on the next connect");
+            }
+
+            return true;
+        }
+
         if (strcmp(name, "FOCUS_BACKLASH_TOGGLE") == 0)
         {
             FocusBacklashSP.s = IPS_OK;
@@ -404,6 +978,9 @@ bool GRBSystems::ISNewNumber (const char *dev, const char *name, double values[]
 {
     if(strcmp(dev,getDeviceName())==0)
     {
+        // The client is about to be sent this property directly
+        propertyShadow.Invalidate(name);
+
         if (!strcmp (name, FocusMaxPosNP.name)) {
             IUUpdateNumber(&FocusMaxPosNP, values, names, n);
             FocusMaxPosNP.s = IPS_OK;
@@ -445,6 +1022,18 @@ bool GRBSystems::ISNewNumber (const char *dev, const char *name, double values[]
 
             return UpdateSpeed(FocusSpeedN[0].value);
         }
+
+        if (sweepProperty.ISNewNumber(name, values, names, n)) {
+            return true;
+        }
+
+        if (!strcmp (name, ReplaySpeedNP.name)) {
+            IUUpdateNumber(&ReplaySpeedNP, values, names, n);
+            ReplaySpeedNP.s = IPS_OK;
+            IDSetNumber(&ReplaySpeedNP, NULL);
+
+            return true;
+        }
     }
 
     return INDI::Focuser::ISNewNumber(dev, name, values, names, n);
@@ -460,6 +1049,11 @@ IPState GRBSystems::MoveAbsFocuser(uint32_t targetTicks)
 {
     DEBUGF(INDI::Logger::DBG_DEBUG, "MoveAbsFocuser", NULL);
 
+    if (sweep.Active()) {
+        DEBUG(INDI::Logger::DBG_WARNING, "Sweep cancelled by a move");
+        EndSweep(IPS_ALERT);
+    }
+
     bool rc;
 
     rc = MoveFocuser(targetTicks);
@@ -473,6 +1067,43 @@ IPState GRBSystems::MoveAbsFocuser(uint32_t targetTicks)
     return IPS_BUSY;
 }
 
+// Computed from the cached report, so the move is the only write.  While
+// a move is under way the step adds to its target, so quick successive
+// steps add up instead of being lost.
+IPState GRBSystems::MoveRelFocuser(FocusDirection dir, uint32_t ticks)
+{
+    if (sweep.Active()) {
+        DEBUG(INDI::Logger::DBG_WARNING, "Sweep cancelled by a move");
+        EndSweep(IPS_ALERT);
+    }
+
+    REPORT current;
+    report.Load(current);
+
+    long from = FocusAbsPosNP.s == IPS_BUSY ? requestedPosition : current.position;
+    long target = dir == FOCUS_INWARD ? from - (long)ticks : from + (long)ticks;
+
+    long maximum = current.maximum;
+    if (maximum > FocusAbsPosN[0].max) {
+        maximum = FocusAbsPosN[0].max;
+    }
+
+    if (target < 0) {
+        target = 0;
+    } else if (target > maximum) {
+        target = maximum;
+    }
+
+    DEBUGF(INDI::Logger::DBG_DEBUG, "Relative move of %u steps from %ld to %ld", ticks, from, target);
+
+    if (!MoveFocuser(target)) {
+        return IPS_ALERT;
+    }
+
+    FocusAbsPosNP.s = IPS_BUSY;
+    return IPS_BUSY;
+}
+
 int GRBSystems::MapPulse(int pulse) {
     int speed = 1;
     for(int i=0; i<5; i++){
@@ -485,110 +1116,394 @@ int GRBSystems::MapPulse(int pulse) {
     return speed;
 }
 
-void GRBSystems::TimerHit() {
+void GRBSystems::ReportReady(int fd, void *p)
+{
+    GRBSystems* sys = (GRBSystems*)p;
+
+    // Several reports may have been flagged since we last ran; the
+    // snapshot below covers all of them.
+    uint64_t count;
+    if(read(fd, &count, sizeof(count)) != sizeof(count)){
+        return;
+    }
+
+    sys->PublishReport();
+}
+
+void GRBSystems::PublishReport() {
 
     if (isConnected() == false) {
-        timerid = SetTimer(POLL_MS);
         return;
     }
 
-    if (handle == NULL) {
-        DEBUGF(INDI::Logger::DBG_ERROR, "isConnected is true, but there is no hid handle!", NULL);
-        timerid = SetTimer(POLL_MS);
+    if (transport == NULL) {
+        DEBUGF(INDI::Logger::DBG_ERROR, "isConnected is true, but there is no hid transport!", NULL);
+        return;
+    }
+
+    // The reader thread cannot log, so what it saw is reported here
+    if (readerLost && !lostLogged) {
+        lostLogged = true;
+        DEBUG(INDI::Logger::DBG_ERROR, "GRBSystems stopped responding, reconnect to resume");
+    }
+
+    unsigned long failures = wakeFailures;
+    if (failures != wakeFailuresLogged) {
+        DEBUGF(INDI::Logger::DBG_DEBUG, "Report event write failed %lu times", failures - wakeFailuresLogged);
+        wakeFailuresLogged = failures;
+    }
+
+    REPORT current;
+    unsigned long seq = report.Load(current);
+
+    // The device has reported since the last move went out, so the next
+    // one can follow.
+    if (moveInFlight && seq != moveReportSeq) {
+        moveInFlight = false;
+        if (moves.Pending()) {
+            SendMove();
+        }
+    }
+
+    // Follow the device for preferences this session has not set
+    MergePrefs(current);
+
+    long target = targetPos;
+
+    // Nothing new from the device and no new move since the last update
+    if (seq == lastReportSeq && target == lastTargetPos) {
         return;
     }
 
+    lastReportSeq = seq;
+    lastTargetPos = target;
 
-    FocusAbsPosN[0].value = report.position;
+    FocusAbsPosN[0].value = current.position;
     FocusAbsPosN[0].min = 0.;
     FocusAbsPosN[0].max = 22500.;
     FocusAbsPosN[0].step = 100;
 
-    FocusMaxPosN[0].value = report.maximum;
+    FocusMaxPosN[0].value = current.maximum;
     FocusMaxPosN[0].max = 65535;
     FocusMaxPosN[0].min = 2000;
     FocusMaxPosN[0].step = 100;
 
-    FocusBacklashN[0].value = report.backlash;
+    FocusBacklashN[0].value = current.backlash;
     FocusBacklashN[0].max = 255;
     FocusBacklashN[0].min = 0;
     FocusBacklashN[0].step = 5;
 
-    if (report.isMoving || (targetPos != report.position)) {
+    // Until a report newer than the move arrives, assume it is under way
+    if (current.isMoving || seq == moveReportSeq || (target != (long)current.position)) {
         FocusAbsPosNP.s = IPS_BUSY;
     } else {
         FocusAbsPosNP.s = IPS_OK;
     }
 
-    FocusSpeedN[0].value = MapPulse(report.pulse);
+    if (FocusRelPosNP.s == IPS_BUSY && FocusAbsPosNP.s == IPS_OK) {
+        FocusRelPosNP.s = IPS_OK;
+    }
+
+    FocusSpeedN[0].value = MapPulse(current.pulse);
+
+    propertyShadow.SetNumber(&FocusAbsPosNP);
+    propertyShadow.SetNumber(&FocusRelPosNP);
+    propertyShadow.SetNumber(&FocusMaxPosNP);
+    propertyShadow.SetNumber(&FocusSyncNP);
+    propertyShadow.SetNumber(&FocusBacklashNP);
+    propertyShadow.SetNumber(&FocusSpeedNP);
+
+    estimateProperty.Start();
+    CheckSweep(current, seq);
+    PublishStats();
+}
+
+// The estimate follows the reports; reports only come while the device
+// has something to say.
+bool GRBSystems::MotionState(void *arg, CMotionEstimateProperty::MOTION_STATE &state)
+{
+    GRBSystems* sys = (GRBSystems*)arg;
+
+    if (!sys->isConnected()) {
+        return false;
+    }
+
+    REPORT current;
+    sys->report.Load(current);
+
+    state.model = &sys->motion;
+    state.position = current.position;
+    state.key = current.pulse;
+    state.moving = sys->FocusAbsPosNP.s == IPS_BUSY;
+    return true;
+}
+
+void GRBSystems::SweepStep()
+{
+    if(sweepTimer != -1){
+        IERmTimer(sweepTimer);
+        sweepTimer = -1;
+    }
+
+    if(!MoveFocuser(sweep.Target())){
+        EndSweep(IPS_ALERT);
+        return;
+    }
 
+    FocusAbsPosNP.s = IPS_BUSY;
     IDSetNumber(&FocusAbsPosNP, NULL);
-    IDSetNumber(&FocusMaxPosNP, NULL);
-    IDSetNumber(&FocusSyncNP, NULL);
-    IDSetNumber(&FocusBacklashNP, NULL);
-    IDSetNumber(&FocusSpeedNP, NULL);
+    propertyShadow.Invalidate(FocusAbsPosNP.name);
+}
+
+// Arrival is the first report newer than the move that has the focuser
+// stopped on the target.  Reports stream while the focuser moves, so
+// this is as tight as the device reports.
+void GRBSystems::CheckSweep(const REPORT &current, unsigned long seq)
+{
+    if(!sweep.Active() || sweepTimer != -1){
+        return;
+    }
+
+    if(moveInFlight || moves.Pending() || seq == moveReportSeq){
+        return;
+    }
+
+    if(current.isMoving || current.position != sweep.Target()){
+        return;
+    }
+
+    unsigned int settleMs = sweepProperty.SettleMs();
+    if(settleMs > 0){
+        sweepTimer = IEAddTimer(settleMs, SweepSettled, this);
+        return;
+    }
+
+    SweepArrived();
+}
+
+void GRBSystems::SweepSettled(void *p)
+{
+    GRBSystems* sys = (GRBSystems*)p;
+
+    sys->sweepTimer = -1;
+    sys->SweepArrived();
+}
+
+void GRBSystems::SweepArrived()
+{
+    if(sweep.AtSample()){
+        sweepProperty.Arrived(sweep);
+    }
+
+    if(sweep.Advance()){
+        SweepStep();
+        return;
+    }
+
+    EndSweep(IPS_OK);
+}
+
+void GRBSystems::EndSweep(IPState state)
+{
+    if(sweepTimer != -1){
+        IERmTimer(sweepTimer);
+        sweepTimer = -1;
+    }
+
+    sweep.Cancel();
+    sweepProperty.Finished(state);
+}
+
+// No report acknowledged the last move in time; send the held one anyway
+void GRBSystems::MoveTimeout(void *p)
+{
+    GRBSystems* sys = (GRBSystems*)p;
+
+    sys->moveTimer = -1;
+    sys->moveInFlight = false;
+
+    if (sys->isConnected() && sys->moves.Pending()) {
+        sys->SendMove();
+    }
+}
+
+void GRBSystems::TimerHit()
+{
+    statsTimer = -1;
 
-    timerid = SetTimer(POLL_MS);
+    if (isConnected() == false) {
+        return;
+    }
+
+    PublishStats();
+    statsTimer = SetTimer(STATS_PERIOD_MS);
 }
 
-void* GRBSystems::Reader(void *thread_params)
+// The counters change on every update, so they bypass the shadow and are
+// sent on a slow fixed period instead.
+void GRBSystems::PublishStats()
 {
-    GRBSystems* sys = (GRBSystems*)thread_params;
+    unsigned long long now = MonotonicMs();
+    if(now - lastStatsMs < STATS_PERIOD_MS){
+        return;
+    }
 
-    sys->DoRead();
+    lastStatsMs = now;
 
-    return NULL;
+    PublishStatsN[0].value = propertyShadow.Emitted();
+    PublishStatsN[1].value = propertyShadow.Suppressed();
+    PublishStatsNP.s = IPS_OK;
+    IDSetNumber(&PublishStatsNP, NULL);
+
+    MoveStatsN[0].value = moves.Offered();
+    MoveStatsN[1].value = moves.Sent();
+    MoveStatsN[2].value = moves.Coalesced();
+    MoveStatsNP.s = IPS_OK;
+    IDSetNumber(&MoveStatsNP, NULL);
+
+    PrefsStatsN[0].value = prefsRequested;
+    PrefsStatsN[1].value = prefsWritten;
+    PrefsStatsN[2].value = prefsRequested - prefsWritten;
+    PrefsStatsNP.s = IPS_OK;
+    IDSetNumber(&PrefsStatsNP, NULL);
+
+    busStatsProperty.Publish(busStats);
+    busHealthProperty.Publish(writePolicy);
+}
+
+void GRBSystems::ReportReceived(const unsigned char *buf, int len, void *arg)
+{
+    GRBSystems* sys = (GRBSystems*)arg;
+
+    sys->HandleReport(buf, len);
 }
 
 #define DATA_OFFSET  4
 
-void GRBSystems::DoRead()
+static bool SameReport(const REPORT &a, const REPORT &b)
 {
-    int res;
-    unsigned char buf[BUF_SIZE];
+    return a.isMoving == b.isMoving &&
+           a.position == b.position &&
+           a.maximum == b.maximum &&
+           a.pulse == b.pulse &&
+           a.direction == b.direction &&
+           a.backlash == b.backlash &&
+           a.microns == b.microns;
+}
 
-    while(keep_running){
+// Runs on the reader thread.  A failed write is only counted; the INDI
+// thread logs it the next time it runs.
+void GRBSystems::WakeInterface()
+{
+    uint64_t one = 1;
+    if(write(reportFd, &one, sizeof(one)) != sizeof(one)){
+        wakeFailures++;
+    }
+}
+
+// Runs on the reader thread
+void GRBSystems::HandleReport(const unsigned char *buf, int len)
+{
+    REPORT decoded;
+
+    if (len < 0) {
         haveReport = false;
-        res = hid_read(handle, buf, BUF_SIZE);
-        if (res == BUF_SIZE) {
-            report.isMoving = (buf[DATA_OFFSET] != 0);
-            report.position = buf[DATA_OFFSET + 2] + (buf[DATA_OFFSET + 1] << 8);
-            report.maximum = buf[DATA_OFFSET + 4] + (buf[DATA_OFFSET + 3] << 8);
-            report.pulse = buf[DATA_OFFSET + 5];
-            report.direction = buf[DATA_OFFSET + 6];
-            report.backlash = buf[DATA_OFFSET + 8] + (buf[DATA_OFFSET + 7] << 8);
-            report.microns = buf[DATA_OFFSET + 10] + (buf[DATA_OFFSET + 9] << 8);
-
-            if(targetPos == -1){
-                targetPos = report.position;
-            }
+        readerLost = true;
+        WakeInterface();
+        return;
+    }
 
-            haveReport = true;
-        }
+    if (len != BUF_SIZE) {
+        return;
+    }
+
+    decoded.isMoving = (buf[DATA_OFFSET] != 0);
+    decoded.position = buf[DATA_OFFSET + 2] + (buf[DATA_OFFSET + 1] << 8);
+    decoded.maximum = buf[DATA_OFFSET + 4] + (buf[DATA_OFFSET + 3] << 8);
+    decoded.pulse = buf[DATA_OFFSET + 5];
+    decoded.direction = buf[DATA_OFFSET + 6];
+    decoded.backlash = buf[DATA_OFFSET + 8] + (buf[DATA_OFFSET + 7] << 8);
+    decoded.microns = buf[DATA_OFFSET + 10] + (buf[DATA_OFFSET + 9] << 8);
+
+    report.Store(decoded);
+
+    unsigned long long us = MonotonicUs();
+    long target = targetPos;
+    motion.Sample(us, decoded.position, target < 0 ? decoded.position : target, decoded.isMoving, decoded.pulse);
+
+    long values[] = { decoded.isMoving, (long)decoded.position, (long)decoded.maximum, (long)decoded.pulse,
+                      (long)decoded.direction, (long)decoded.backlash, (long)decoded.microns };
+    telemetryProperty.Log().Append(us, values);
+
+    // After an abort the target is wherever the focuser stops.  A
+    // report still in flight from before the stop must not set it.
+    if(!decoded.isMoving){
+        long unset = -1;
+        targetPos.compare_exchange_strong(unset, decoded.position);
+    }
+
+    haveReport = true;
+
+    // Wake the INDI thread only when something a client can see changed
+    unsigned long pending = moveCount;
+    if(readerFirst || pending != readerMoves || !SameReport(decoded, readerLast)){
+        WakeInterface();
+
+        readerLast = decoded;
+        readerFirst = false;
+        readerMoves = pending;
     }
 }
 
 
 
+// The stop goes out ahead of anything still waiting to be written: a
+// held move is dropped, and a pending preferences write is pushed back
+// behind it.
 bool GRBSystems::AbortFocuser()
 {
+    unsigned long long startUs = MonotonicUs();
+
     DEBUGF(INDI::Logger::DBG_DEBUG, "Aborting Move", NULL);
 
+    if(sweep.Active()){
+        DEBUG(INDI::Logger::DBG_SESSION, "Sweep aborted");
+        EndSweep(IPS_ALERT);
+    }
+
     unsigned char buf[BUF_SIZE];
 
     buf[0] = 0x00;      // Header byte
     buf[1] = 0x13;      // Stop
     buf[2] = 0x00;      // Channel 0
 
+    // A held move must not start once the focuser has stopped
+    moves.Cancel();
+    if(moveTimer != -1){
+        IERmTimer(moveTimer);
+        moveTimer = -1;
+    }
+
+    if(prefsTimer != -1){
+        IERmTimer(prefsTimer);
+        prefsTimer = IEAddTimer(PREFS_DEBOUNCE_MS, PrefsTimeout, this);
+    }
+
+    // Force a position reset.  This must happen before the write: the
+    // report acknowledging the stop can arrive before Write() returns,
+    // and no further report is sent once the focuser is idle.
+    targetPos = -1;
+    moveCount++;
+
     int res;
-    res = hid_write(handle, buf, BUF_SIZE);
+    res = WriteReport(buf, true);
+
+    abortLatencyProperty.Record(MonotonicUs() - startUs, res == BUF_SIZE);
+
     if(res != BUF_SIZE){
         DEBUGF(INDI::Logger::DBG_ERROR, "Failed to stop: %d bytes sent", res);
         return false;
     }
 
-    // Force a position reset
-    targetPos = -1;
-
     return true;
 }
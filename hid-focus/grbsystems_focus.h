@@ -18,8 +18,20 @@
 #ifndef GRBSYSTEMS_H
 #define GRBSYSTEMS_H
 
+#include <atomic>
+
 #include "indifocuser.h"
-#include "hidapi.h"
+#include "hid_transport.h"
+
+#include "property-shadow.h"
+#include "bus-stats-property.h"
+#include "retry-policy-property.h"
+#include "abort-latency-property.h"
+#include "seqlock.h"
+#include "move-coalescer.h"
+#include "motion-estimate-property.h"
+#include "telemetry-log-property.h"
+#include "focus-sweep-property.h"
 
 typedef struct _report {
     bool isMoving;
@@ -48,39 +60,164 @@ public:
 
     virtual bool ISNewNumber (const char *dev, const char *name, double values[], char *names[], int n);
     virtual bool ISNewSwitch (const char *dev, const char *name, ISState *states, char *names[], int n);
+    virtual bool ISNewText (const char *dev, const char *name, char *texts[], char *names[], int n);
+    virtual void ISGetProperties(const char *dev);
+    virtual bool saveConfigItems(FILE *fp);
 
     virtual IPState MoveAbsFocuser(uint32_t ticks);
+    virtual IPState MoveRelFocuser(FocusDirection dir, uint32_t ticks);
 
     virtual bool AbortFocuser();
     virtual void TimerHit();
 
 private:
-    int timerid;
-    hid_device *handle;
-    pthread_t reader_thread;
-
-    double targetPos;
-
-    bool haveReport;
-    bool keep_running;
-
-    REPORT report;
+    CHidTransport *transport;
+
+    // Shared with the reader thread
+    std::atomic<long> targetPos;
+    // Bumped for every move or stop, so one that leaves the focuser where
+    // it is still wakes the INDI thread although the report is unchanged.
+    std::atomic<unsigned long> moveCount;
+    std::atomic<bool> haveReport;
+    // Raised by the reader thread, logged on the INDI thread
+    std::atomic<bool> readerLost;
+    std::atomic<unsigned long> wakeFailures;
+    bool lostLogged;
+    unsigned long wakeFailuresLogged;
+
+    CSeqLock<REPORT> report;
+
+    // Step rate per pulse setting, learned from the reports; estimates
+    // are published between them.
+    CMotionModel motion;
+    CMotionEstimateProperty estimateProperty;
+
+    // Reader thread only: the last report that woke the INDI thread
+    bool readerFirst;
+    REPORT readerLast;
+    unsigned long readerMoves;
+
+    // Reader thread to INDI event loop wakeup
+    int reportFd;
+    int reportCallback;
+
+    // Sequence of the last report published, and the report that was
+    // current when the last move was sent.
+    unsigned long lastReportSeq;
+    long lastTargetPos;
+    unsigned long moveReportSeq;
+
+    // INDI thread only.  At most one move is out ahead of the reports;
+    // later targets wait in moves for the next report or moveTimer.
+    CMoveCoalescer moves;
+    bool moveInFlight;
+    int moveTimer;
+    // The last target asked for; relative moves made while it is still
+    // being reached step from here.
+    unsigned int requestedPosition;
+
+    // INDI thread only.  The preferences we want the device to have.
+    // Fields in prefsOwned were set by this session and no longer follow
+    // the reports; those in prefsDirty wait for prefsTimer to write them.
+    // Fields in prefsFailed were in a write that failed and is retried.
+    REPORT prefs;
+    bool prefsValid;
+    int prefsOwned;
+    int prefsDirty;
+    int prefsFailed;
+    int prefsTimer;
+    unsigned long prefsRequested;
+    unsigned long prefsWritten;
+
+    enum { TRANSPORT_LIVE, TRANSPORT_RECORD, TRANSPORT_REPLAY };
+    enum { BACKEND_HIDRAW, BACKEND_HIDAPI };
+
+    IText SerialT[1] {};
+    ITextVectorProperty SerialTP;
+
+    // Every input report, recorded on the reader thread
+    CTelemetryLogProperty telemetryProperty;
+
+    ISwitch TransportModeS[3];
+    ISwitchVectorProperty TransportModeSP;
+
+    // How a live controller is reached: hidraw directly, or hidapi
+    ISwitch BackendS[2];
+    ISwitchVectorProperty BackendSP;
+
+    IText CaptureFileT[1] {};
+    ITextVectorProperty CaptureFileTP;
+
+    INumber ReplaySpeedN[1];
+    INumberVectorProperty ReplaySpeedNP;
+
+    CPropertyShadow propertyShadow;
+    unsigned long long lastStatsMs;
+
+    INumber PublishStatsN[2];
+    INumberVectorProperty PublishStatsNP;
+
+    INumber MoveStatsN[3];
+    INumberVectorProperty MoveStatsNP;
+
+    INumber PrefsStatsN[3];
+    INumberVectorProperty PrefsStatsNP;
+
+    // Per report count, retries, failures and latency, filled by the
+    // transport on whichever thread uses it
+    CBusStats busStats;
+    CBusStatsProperty busStatsProperty;
+    int statsTimer;
+
+    // Driver side autofocus sweep; sweepTimer runs the settle delay
+    CFocusSweep sweep;
+    CFocusSweepProperty sweepProperty;
+    int sweepTimer;
+
+    // Retries and the breaker for reports written from the INDI thread
+    CRetryPolicy writePolicy;
+    CRetryPolicyProperty busHealthProperty;
+    int busState;
+
+    // Abort request to the stop report leaving hid_write
+    CAbortLatencyProperty abortLatencyProperty;
 
     void GetFocusParams();
+    CHidTransport *CreateTransport();
+    void PublishStats();
 
     bool MoveFocuser(unsigned int position);
+    bool SendMove();
+    static void MoveTimeout(void *p);
 
     bool UpdateMaxTravel(unsigned int position);
     bool UpdateCurPos(unsigned int position);
     bool UpdateBacklash(unsigned int position);
     bool UpdateSpeed(unsigned int speed);
     bool UpdateDirection(bool outPositive);
-    bool UpdatePrefs(REPORT *prefs);
+    int WriteReport(unsigned char *buf, bool urgent = false);
+    bool UpdatePrefs(int fields);
+    bool WritePrefs();
+    void SetPrefsState(int fields, IPState state);
+    void MergePrefs(const REPORT &current);
+    static void PrefsTimeout(void *p);
 
     int MapPulse(int pulse);
 
-    static void* Reader(void *thread_params);
-    void DoRead();
+    static void ReportReceived(const unsigned char *buf, int len, void *arg);
+    void HandleReport(const unsigned char *buf, int len);
+    void WakeInterface();
+
+    static void ReportReady(int fd, void *p);
+    void PublishReport();
+
+    void SweepStep();
+    void CheckSweep(const REPORT &current, unsigned long seq);
+    static void SweepSettled(void *p);
+    void SweepArrived();
+    void EndSweep(IPState state);
+
+    static bool MotionState(void *arg, CMotionEstimateProperty::MOTION_STATE &state);
 };
 
 #endif
@@ -0,0 +1,249 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#include "hid_reader.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define REPORT_SIZE 64
+#define MAX_EVENTS 16
+// Reports taken from one controller before the others get a turn
+#define MAX_BURST 8
+// How often transports without a descriptor are read
+#define TICK_MS 5
+
+#define WAKE_ID 0
+
+CHidReader &CHidReader::Instance()
+{
+    static CHidReader reader;
+    return reader;
+}
+
+CHidReader::CHidReader()
+{
+    pthread_mutex_init(&lock, NULL);
+    nextId = WAKE_ID + 1;
+    ticked = 0;
+
+    epollFd = -1;
+    wakeFd = -1;
+    running = false;
+}
+
+bool CHidReader::Add(CHidTransport *transport, HID_REPORT_HANDLER handler, void *arg)
+{
+    pthread_mutex_lock(&lock);
+
+    if(!running){
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = WAKE_ID;
+
+        if(epollFd < 0 || wakeFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) != 0){
+            pthread_mutex_unlock(&lock);
+            Stop();
+            return false;
+        }
+
+        running = true;
+        if(pthread_create(&thread, NULL, Main, this)){
+            running = false;
+            pthread_mutex_unlock(&lock);
+            Stop();
+            return false;
+        }
+    }
+
+    SOURCE source;
+    source.transport = transport;
+    source.handler = handler;
+    source.arg = arg;
+    source.fd = transport->PollFd();
+
+    unsigned long id = nextId++;
+
+    if(source.fd >= 0){
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = id;
+
+        if(epoll_ctl(epollFd, EPOLL_CTL_ADD, source.fd, &ev) != 0){
+            pthread_mutex_unlock(&lock);
+            return false;
+        }
+    } else {
+        ticked++;
+    }
+
+    sources[id] = source;
+    pthread_mutex_unlock(&lock);
+
+    // The thread may be waiting with no timeout and needs to pick up a
+    // new ticked source
+    uint64_t one = 1;
+    if(write(wakeFd, &one, sizeof(one)) != sizeof(one)){
+        // Already signalled
+    }
+
+    return true;
+}
+
+// Called with the lock held
+void CHidReader::Drop(std::map<unsigned long, SOURCE>::iterator it)
+{
+    if(it->second.fd >= 0){
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, NULL);
+    } else {
+        ticked--;
+    }
+
+    sources.erase(it);
+}
+
+void CHidReader::Remove(CHidTransport *transport)
+{
+    pthread_mutex_lock(&lock);
+
+    std::map<unsigned long, SOURCE>::iterator it;
+    for(it = sources.begin(); it != sources.end(); ++it){
+        if(it->second.transport == transport){
+            Drop(it);
+            break;
+        }
+    }
+
+    bool last = running && sources.empty();
+    pthread_mutex_unlock(&lock);
+
+    if(last){
+        Stop();
+    }
+}
+
+void CHidReader::Stop()
+{
+    pthread_mutex_lock(&lock);
+    bool wasRunning = running;
+    running = false;
+    pthread_mutex_unlock(&lock);
+
+    if(wasRunning){
+        uint64_t one = 1;
+        if(write(wakeFd, &one, sizeof(one)) != sizeof(one)){
+            // Already signalled
+        }
+
+        pthread_join(thread, NULL);
+    }
+
+    if(epollFd >= 0){
+        close(epollFd);
+        epollFd = -1;
+    }
+
+    if(wakeFd >= 0){
+        close(wakeFd);
+        wakeFd = -1;
+    }
+}
+
+void *CHidReader::Main(void *arg)
+{
+    ((CHidReader *)arg)->Run();
+    return NULL;
+}
+
+void CHidReader::Run()
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    pthread_mutex_lock(&lock);
+
+    while(running){
+        int timeout = ticked > 0 ? TICK_MS : -1;
+
+        pthread_mutex_unlock(&lock);
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+        pthread_mutex_lock(&lock);
+
+        for(int i = 0; i < n && running; i++){
+            if(events[i].data.u64 == WAKE_ID){
+                uint64_t count;
+                if(read(wakeFd, &count, sizeof(count)) != sizeof(count)){
+                    // Nothing pending
+                }
+                continue;
+            }
+
+            // Looked up again as it may have been removed meanwhile
+            Service(events[i].data.u64);
+        }
+
+        if(ticked > 0){
+            std::map<unsigned long, SOURCE>::iterator it = sources.begin();
+            while(it != sources.end()){
+                unsigned long id = it->first;
+                bool poll = it->second.fd < 0;
+                ++it;
+
+                if(poll){
+                    Service(id);
+                }
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+// Called with the lock held
+void CHidReader::Service(unsigned long id)
+{
+    std::map<unsigned long, SOURCE>::iterator it = sources.find(id);
+    if(it == sources.end()){
+        return;
+    }
+
+    SOURCE &source = it->second;
+    unsigned char buf[REPORT_SIZE];
+
+    for(int i = 0; i < MAX_BURST; i++){
+        int res = source.transport->Read(buf, REPORT_SIZE, 0);
+        if(res == 0){
+            break;
+        }
+
+        if(res < 0){
+            // A failed device would otherwise keep the descriptor ready
+            // and spin the thread
+            source.handler(NULL, -1, source.arg);
+            Drop(it);
+            break;
+        }
+
+        source.handler(buf, res, source.arg);
+    }
+}
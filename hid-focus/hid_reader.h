@@ -0,0 +1,74 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#ifndef HID_READER_H
+#define HID_READER_H
+
+#include <pthread.h>
+#include <map>
+
+#include "hid_transport.h"
+
+// Called on the reader thread with every input report, or with a length
+// of -1 once the transport has failed and been dropped from the reader.
+typedef void (*HID_REPORT_HANDLER)(const unsigned char *buf, int len, void *arg);
+
+// One thread reads input reports for every connected controller.
+// Transports with a PollFd are waited on with epoll; the rest are read
+// without blocking on a short shared tick.  The thread starts with the
+// first transport added and stops when the last is removed.
+class CHidReader
+{
+public:
+    static CHidReader &Instance();
+
+    bool Add(CHidTransport *transport, HID_REPORT_HANDLER handler, void *arg);
+
+    // Once this returns the handler will not be called again for the
+    // transport, so it can be closed.
+    void Remove(CHidTransport *transport);
+
+private:
+    CHidReader();
+
+    typedef struct _source {
+        CHidTransport *transport;
+        HID_REPORT_HANDLER handler;
+        void *arg;
+        int fd;
+    } SOURCE;
+
+    // Held while sources are serviced, so Remove waits out a pass
+    pthread_mutex_t lock;
+    std::map<unsigned long, SOURCE> sources;
+    unsigned long nextId;
+    int ticked;
+
+    int epollFd;
+    int wakeFd;
+    pthread_t thread;
+    bool running;
+
+    static void *Main(void *arg);
+    void Run();
+    void Service(unsigned long id);
+    void Drop(std::map<unsigned long, SOURCE>::iterator it);
+    void Stop();
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "hid_simulator.h"
+#include "monotonic-clock.h"
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#define REPORT_SIZE 64
+#define DATA_OFFSET 4
+
+// The firmware sends a report every 20ms and steps once per
+// (pulse + 1) * 250us.
+#define STREAM_US 20000
+#define STEP_US 250
+
+HID_PROBE CHidSimulator::probe = NULL;
+void *CHidSimulator::probeArg = NULL;
+
+void CHidSimulator::SetProbe(HID_PROBE probe, void *arg)
+{
+    CHidSimulator::probe = probe;
+    CHidSimulator::probeArg = arg;
+}
+
+CHidSimulator::CHidSimulator()
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&changed, &attr);
+    pthread_condattr_destroy(&attr);
+    dirty = false;
+
+    position = 10000;
+    target = 10000;
+    maximum = 22500;
+    pulse = 0;
+    direction = 0;
+    backlash = 0;
+    microns = 100;
+
+    lastStepUs = 0;
+    nextReportUs = 0;
+    timerFd = -1;
+}
+
+CHidSimulator::~CHidSimulator()
+{
+    Close();
+
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&lock);
+}
+
+bool CHidSimulator::Open()
+{
+    lastStepUs = MonotonicUs();
+    nextReportUs = lastStepUs;
+
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timerFd < 0){
+        return false;
+    }
+
+    Arm(0);
+    return true;
+}
+
+void CHidSimulator::Close()
+{
+    if(timerFd >= 0){
+        close(timerFd);
+        timerFd = -1;
+    }
+}
+
+// One shot, re-armed by every read and write so it tracks nextReportUs
+void CHidSimulator::Arm(unsigned long long us)
+{
+    if(timerFd < 0){
+        return;
+    }
+
+    // A zero value would disarm the timer
+    if(us == 0){
+        us = 1;
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = us / 1000000;
+    spec.it_value.tv_nsec = (us % 1000000) * 1000;
+
+    timerfd_settime(timerFd, 0, &spec, NULL);
+}
+
+// Called with the lock held
+void CHidSimulator::Advance()
+{
+    unsigned long long now = MonotonicUs();
+    unsigned long long period = (pulse + 1) * STEP_US;
+    unsigned long long steps = (now - lastStepUs) / period;
+
+    if(position == target){
+        lastStepUs = now;
+        return;
+    }
+
+    lastStepUs += steps * period;
+
+    unsigned int remaining = position < target ? target - position : position - target;
+    if(steps > remaining){
+        steps = remaining;
+    }
+
+    if(position < target){
+        position += steps;
+    } else {
+        position -= steps;
+    }
+}
+
+int CHidSimulator::Read(unsigned char *buf, size_t len, int timeoutMs)
+{
+    unsigned long long deadline = MonotonicUs() + timeoutMs * 1000ULL;
+
+    pthread_mutex_lock(&lock);
+
+    if(timerFd >= 0){
+        uint64_t expirations;
+        if(read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)){
+            // Not expired; this read was not prompted by the timer
+        }
+    }
+
+    // Report on schedule, or straight away once a command has landed
+    while(!dirty){
+        unsigned long long now = MonotonicUs();
+        unsigned long long wake = nextReportUs < deadline ? nextReportUs : deadline;
+        if(now >= wake){
+            break;
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        unsigned long long ns = ts.tv_nsec + (wake - now) * 1000ULL;
+        ts.tv_sec += ns / 1000000000ULL;
+        ts.tv_nsec = ns % 1000000000ULL;
+
+        pthread_cond_timedwait(&changed, &lock, &ts);
+    }
+
+    unsigned long long now = MonotonicUs();
+    if(!dirty && now < nextReportUs){
+        Arm(nextReportUs - now);
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+
+    dirty = false;
+    nextReportUs = now + STREAM_US;
+    Arm(STREAM_US);
+
+    Advance();
+
+    unsigned char report[REPORT_SIZE];
+    memset(report, 0, sizeof(report));
+
+    report[DATA_OFFSET] = position != target;
+    report[DATA_OFFSET + 1] = (position & 0xff00) >> 8;
+    report[DATA_OFFSET + 2] = position & 0x00ff;
+    report[DATA_OFFSET + 3] = (maximum & 0xff00) >> 8;
+    report[DATA_OFFSET + 4] = maximum & 0x00ff;
+    report[DATA_OFFSET + 5] = pulse;
+    report[DATA_OFFSET + 6] = direction;
+    report[DATA_OFFSET + 7] = (backlash & 0xff00) >> 8;
+    report[DATA_OFFSET + 8] = backlash & 0x00ff;
+    report[DATA_OFFSET + 9] = (microns & 0xff00) >> 8;
+    report[DATA_OFFSET + 10] = microns & 0x00ff;
+
+    pthread_mutex_unlock(&lock);
+
+    size_t copy = len < REPORT_SIZE ? len : REPORT_SIZE;
+    memcpy(buf, report, copy);
+
+    return copy;
+}
+
+int CHidSimulator::Write(const unsigned char *buf, size_t len)
+{
+    if(len < 11){
+        return -1;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    Advance();
+
+    unsigned int value = (buf[3] << 8) + buf[4];
+
+    switch(buf[1]){
+        case 0x11:      // Move Abs
+            target = value < maximum ? value : maximum;
+            lastStepUs = MonotonicUs();
+            break;
+        case 0x13:      // Stop
+            target = position;
+            break;
+        case 0x16:      // Set Point
+            position = value;
+            target = value;
+            break;
+        case 0x2A:      // Update Prefs
+            maximum = value;
+            pulse = buf[5];
+            direction = buf[6];
+            backlash = (buf[7] << 8) + buf[8];
+            microns = (buf[9] << 8) + buf[10];
+            break;
+    }
+
+    dirty = true;
+    pthread_cond_signal(&changed);
+    Arm(0);
+
+    pthread_mutex_unlock(&lock);
+
+    if(probe != NULL){
+        probe(buf[1], probeArg);
+    }
+
+    return len;
+}
+
+bool CHidSimulator::GetManufacturer(char *str, size_t len)
+{
+    snprintf(str, len, "GRBSystems (simulated)");
+    return true;
+}
+
+bool CHidSimulator::GetProduct(char *str, size_t len)
+{
+    snprintf(str, len, "Focuser simulator");
+    return true;
+}
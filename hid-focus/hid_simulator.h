@@ -0,0 +1,74 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef HID_SIMULATOR_H
+#define HID_SIMULATOR_H
+
+#include "hid_transport.h"
+
+// Called with the command byte of every report the simulator accepts.
+// Lets benchmarks see exactly when a command reaches the "device".
+typedef void (*HID_PROBE)(unsigned char command, void *arg);
+
+// Stands in for the GRBSystems firmware: accepts move, stop, set point
+// and preference reports and streams input reports the way the real
+// controller does.
+class CHidSimulator : public CHidTransport
+{
+public:
+    CHidSimulator();
+    ~CHidSimulator();
+
+    bool Open();
+    void Close();
+
+    int Read(unsigned char *buf, size_t len, int timeoutMs);
+    int Write(const unsigned char *buf, size_t len);
+
+    bool GetManufacturer(char *str, size_t len);
+    bool GetProduct(char *str, size_t len);
+
+    // Expires whenever the next report is due
+    int PollFd() { return timerFd; }
+
+    static void SetProbe(HID_PROBE probe, void *arg);
+
+private:
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool dirty;
+
+    unsigned int position;
+    unsigned int target;
+    unsigned int maximum;
+    unsigned int pulse;
+    unsigned int direction;
+    unsigned int backlash;
+    unsigned int microns;
+
+    unsigned long long lastStepUs;
+    unsigned long long nextReportUs;
+    int timerFd;
+
+    static HID_PROBE probe;
+    static void *probeArg;
+
+    void Advance();
+    void Arm(unsigned long long us);
+};
+
+#endif
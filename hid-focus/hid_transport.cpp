@@ -0,0 +1,754 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "hid_transport.h"
+#include "monotonic-clock.h"
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define MAX_STR 255
+#define REPORT_SIZE 64
+
+#define SYSFS_HIDRAW "/sys/class/hidraw"
+#define BUS_USB 0x03
+// Longest a write waits for the device to take a report
+#define WRITE_TIMEOUT_MS 100
+
+static bool WideToString(int res, const wchar_t *wstr, char *str, size_t len)
+{
+    if(res != 0){
+        return false;
+    }
+
+    wcstombs(str, wstr, len);
+    str[len - 1] = 0;
+    return true;
+}
+
+// hidraw paths of the controllers open in this process.  Only touched
+// from the INDI thread.
+static std::set<std::string> claimed;
+
+CHidApiTransport::CHidApiTransport(const char *serial)
+{
+    handle = NULL;
+
+    strncpy(this->serial, serial != NULL ? serial : "", sizeof(this->serial) - 1);
+    this->serial[sizeof(this->serial) - 1] = 0;
+    path[0] = 0;
+}
+
+CHidApiTransport::~CHidApiTransport()
+{
+    Close();
+}
+
+bool CHidApiTransport::Open()
+{
+    wchar_t wserial[64];
+    mbstowcs(wserial, serial, 64);
+    wserial[63] = 0;
+
+    struct hid_device_info *devices = hid_enumerate(GRB_VID, GRB_PID);
+
+    for(struct hid_device_info *info = devices; info != NULL && handle == NULL; info = info->next){
+        if(serial[0] != 0 && (info->serial_number == NULL || wcscmp(info->serial_number, wserial) != 0)){
+            continue;
+        }
+
+        if(claimed.count(info->path) != 0){
+            continue;
+        }
+
+        handle = hid_open_path(info->path);
+        if(handle != NULL){
+            strncpy(path, info->path, sizeof(path) - 1);
+            path[sizeof(path) - 1] = 0;
+            claimed.insert(path);
+        }
+    }
+
+    hid_free_enumeration(devices);
+
+    return handle != NULL;
+}
+
+void CHidApiTransport::Close()
+{
+    if(handle != NULL){
+        hid_close(handle);
+        handle = NULL;
+
+        claimed.erase(path);
+        path[0] = 0;
+    }
+}
+
+void CHidApiTransport::List(char *str, size_t len)
+{
+    size_t used = 0;
+    str[0] = 0;
+
+    struct hid_device_info *devices = hid_enumerate(GRB_VID, GRB_PID);
+
+    for(struct hid_device_info *info = devices; info != NULL; info = info->next){
+        char serial[64] = "(none)";
+        if(info->serial_number != NULL){
+            wcstombs(serial, info->serial_number, sizeof(serial));
+            serial[sizeof(serial) - 1] = 0;
+        }
+
+        int n = snprintf(str + used, len - used, "%s%s", used ? ", " : "", serial);
+        if(n < 0 || (size_t)n >= len - used){
+            break;
+        }
+        used += n;
+    }
+
+    hid_free_enumeration(devices);
+}
+
+int CHidApiTransport::Read(unsigned char *buf, size_t len, int timeoutMs)
+{
+    return hid_read_timeout(handle, buf, len, timeoutMs);
+}
+
+int CHidApiTransport::Write(const unsigned char *buf, size_t len)
+{
+    return hid_write(handle, buf, len);
+}
+
+bool CHidApiTransport::GetManufacturer(char *str, size_t len)
+{
+    wchar_t wstr[MAX_STR+1];
+    return WideToString(hid_get_manufacturer_string(handle, wstr, MAX_STR), wstr, str, len);
+}
+
+bool CHidApiTransport::GetProduct(char *str, size_t len)
+{
+    wchar_t wstr[MAX_STR+1];
+    return WideToString(hid_get_product_string(handle, wstr, MAX_STR), wstr, str, len);
+}
+
+
+
+typedef struct _hidraw_info {
+    int index;
+    char node[32];
+    char serial[64];
+    char name[128];
+} HIDRAW_INFO;
+
+static void CopyValue(char *dst, size_t len, const char *src)
+{
+    strncpy(dst, src, len - 1);
+    dst[len - 1] = 0;
+    dst[strcspn(dst, "\n")] = 0;
+}
+
+// The kernel's uevent for a hidraw node carries the ids, serial and
+// name; false unless the node is a GRBSystems controller.
+static bool ReadHidrawInfo(const char *node, HIDRAW_INFO &info)
+{
+    char file[256];
+    snprintf(file, sizeof(file), SYSFS_HIDRAW "/%s/device/uevent", node);
+
+    FILE *fp = fopen(file, "r");
+    if(fp == NULL){
+        return false;
+    }
+
+    unsigned int bus = 0, vid = 0, pid = 0;
+    char line[256];
+
+    memset(&info, 0, sizeof(info));
+    info.index = atoi(node + strlen("hidraw"));
+    CopyValue(info.node, sizeof(info.node), node);
+
+    while(fgets(line, sizeof(line), fp) != NULL){
+        if(strncmp(line, "HID_ID=", 7) == 0){
+            sscanf(line + 7, "%x:%x:%x", &bus, &vid, &pid);
+        } else if(strncmp(line, "HID_UNIQ=", 9) == 0){
+            CopyValue(info.serial, sizeof(info.serial), line + 9);
+        } else if(strncmp(line, "HID_NAME=", 9) == 0){
+            CopyValue(info.name, sizeof(info.name), line + 9);
+        }
+    }
+
+    fclose(fp);
+
+    return bus == BUS_USB && vid == GRB_VID && pid == GRB_PID;
+}
+
+// Attached controllers in hidraw number order
+static std::vector<HIDRAW_INFO> FindHidraw()
+{
+    std::vector<HIDRAW_INFO> found;
+
+    DIR *dir = opendir(SYSFS_HIDRAW);
+    if(dir == NULL){
+        return found;
+    }
+
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL){
+        HIDRAW_INFO info;
+        if(strncmp(entry->d_name, "hidraw", 6) == 0 && ReadHidrawInfo(entry->d_name, info)){
+            found.push_back(info);
+        }
+    }
+
+    closedir(dir);
+
+    std::sort(found.begin(), found.end(), [](const HIDRAW_INFO &a, const HIDRAW_INFO &b)
+    {
+        return a.index < b.index;
+    });
+
+    return found;
+}
+
+CHidRawTransport::CHidRawTransport(const char *serial)
+{
+    fd = -1;
+
+    strncpy(this->serial, serial != NULL ? serial : "", sizeof(this->serial) - 1);
+    this->serial[sizeof(this->serial) - 1] = 0;
+    path[0] = 0;
+    node[0] = 0;
+    name[0] = 0;
+}
+
+CHidRawTransport::~CHidRawTransport()
+{
+    Close();
+}
+
+bool CHidRawTransport::Open()
+{
+    std::vector<HIDRAW_INFO> found = FindHidraw();
+
+    for(size_t i = 0; i < found.size() && fd < 0; i++){
+        const HIDRAW_INFO &info = found[i];
+        char devPath[sizeof(path)];
+
+        if(serial[0] != 0 && strcmp(info.serial, serial) != 0){
+            continue;
+        }
+
+        snprintf(devPath, sizeof(devPath), "/dev/%s", info.node);
+        if(claimed.count(devPath) != 0){
+            continue;
+        }
+
+        fd = open(devPath, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if(fd >= 0){
+            strcpy(path, devPath);
+            strcpy(node, info.node);
+            strcpy(name, info.name);
+            claimed.insert(path);
+        }
+    }
+
+    return fd >= 0;
+}
+
+void CHidRawTransport::Close()
+{
+    if(fd >= 0){
+        close(fd);
+        fd = -1;
+
+        claimed.erase(path);
+        path[0] = 0;
+    }
+}
+
+void CHidRawTransport::List(char *str, size_t len)
+{
+    size_t used = 0;
+    str[0] = 0;
+
+    std::vector<HIDRAW_INFO> found = FindHidraw();
+
+    for(size_t i = 0; i < found.size(); i++){
+        int n = snprintf(str + used, len - used, "%s%s", used ? ", " : "", found[i].serial[0] ? found[i].serial : "(none)");
+        if(n < 0 || (size_t)n >= len - used){
+            break;
+        }
+        used += n;
+    }
+}
+
+// Each read returns one whole input report.  A device that has gone
+// away reads as an error rather than as nothing to read.
+int CHidRawTransport::Read(unsigned char *buf, size_t len, int timeoutMs)
+{
+    if(fd < 0){
+        return -1;
+    }
+
+    for(;;){
+        ssize_t res = read(fd, buf, len);
+        if(res > 0){
+            return res;
+        }
+
+        if(res < 0 && errno == EINTR){
+            continue;
+        }
+
+        if(res == 0 || errno != EAGAIN){
+            return -1;
+        }
+
+        if(timeoutMs == 0){
+            return 0;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        int ready = poll(&pfd, 1, timeoutMs);
+        if(ready <= 0){
+            return 0;
+        }
+
+        if(!(pfd.revents & POLLIN)){
+            return -1;
+        }
+
+        // Read what is there, but never wait a second time
+        timeoutMs = 0;
+    }
+}
+
+// Like hid_write, buf starts with the report number
+int CHidRawTransport::Write(const unsigned char *buf, size_t len)
+{
+    if(fd < 0){
+        return -1;
+    }
+
+    bool waited = false;
+
+    for(;;){
+        ssize_t res = write(fd, buf, len);
+        if(res >= 0){
+            return res;
+        }
+
+        if(errno == EINTR){
+            continue;
+        }
+
+        if(errno != EAGAIN || waited){
+            return -1;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+
+        if(poll(&pfd, 1, WRITE_TIMEOUT_MS) <= 0 || !(pfd.revents & POLLOUT)){
+            return -1;
+        }
+
+        waited = true;
+    }
+}
+
+// USB string attributes live on the USB device, two levels above the
+// HID device the hidraw node belongs to.
+bool CHidRawTransport::ReadAttribute(const char *attribute, char *str, size_t len)
+{
+    char file[256];
+    snprintf(file, sizeof(file), SYSFS_HIDRAW "/%s/device/../../%s", node, attribute);
+
+    FILE *fp = fopen(file, "r");
+    if(fp == NULL){
+        return false;
+    }
+
+    char value[MAX_STR + 1];
+    bool ok = fgets(value, sizeof(value), fp) != NULL;
+    fclose(fp);
+
+    if(ok){
+        CopyValue(str, len, value);
+    }
+
+    return ok;
+}
+
+bool CHidRawTransport::GetManufacturer(char *str, size_t len)
+{
+    return fd >= 0 && ReadAttribute("manufacturer", str, len);
+}
+
+bool CHidRawTransport::GetProduct(char *str, size_t len)
+{
+    if(fd < 0){
+        return false;
+    }
+
+    if(ReadAttribute("product", str, len)){
+        return true;
+    }
+
+    // The HID name is the manufacturer and product together
+    CopyValue(str, len, name);
+    return name[0] != 0;
+}
+
+
+CHidRecorder::CHidRecorder(CHidTransport *live, const char *path)
+{
+    this->live = live;
+    strncpy(this->path, path, sizeof(this->path) - 1);
+    this->path[sizeof(this->path) - 1] = 0;
+
+    fp = NULL;
+    lastUs = 0;
+
+    pthread_mutex_init(&lock, NULL);
+}
+
+CHidRecorder::~CHidRecorder()
+{
+    Close();
+    delete live;
+
+    pthread_mutex_destroy(&lock);
+}
+
+bool CHidRecorder::Open()
+{
+    if(!live->Open()){
+        return false;
+    }
+
+    fp = fopen(path, "wb");
+    if(fp == NULL){
+        live->Close();
+        return false;
+    }
+
+    unsigned char header[6];
+    memcpy(header, CAPTURE_MAGIC, 4);
+    header[4] = CAPTURE_VERSION;
+    header[5] = REPORT_SIZE;
+    fwrite(header, 1, sizeof(header), fp);
+
+    lastUs = MonotonicUs();
+
+    return true;
+}
+
+void CHidRecorder::Close()
+{
+    live->Close();
+
+    pthread_mutex_lock(&lock);
+    if(fp != NULL){
+        fclose(fp);
+        fp = NULL;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void CHidRecorder::Record(unsigned char direction, const unsigned char *buf, size_t len)
+{
+    if(len > REPORT_SIZE){
+        len = REPORT_SIZE;
+    }
+
+    // Reports are mostly padding
+    while(len > 0 && buf[len - 1] == 0){
+        len--;
+    }
+
+    unsigned char record[1 + 10 + 1 + REPORT_SIZE];
+    int n = 0;
+
+    pthread_mutex_lock(&lock);
+
+    if(fp != NULL){
+        unsigned long long now = MonotonicUs();
+        unsigned long long delta = now - lastUs;
+        lastUs = now;
+
+        record[n++] = direction;
+        do {
+            unsigned char byte = delta & 0x7f;
+            delta >>= 7;
+            record[n++] = byte | (delta ? 0x80 : 0);
+        } while(delta);
+        record[n++] = len;
+        memcpy(record + n, buf, len);
+        n += len;
+
+        fwrite(record, 1, n, fp);
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+int CHidRecorder::Read(unsigned char *buf, size_t len, int timeoutMs)
+{
+    int res = live->Read(buf, len, timeoutMs);
+    if(res > 0){
+        Record(CAPTURE_INPUT, buf, res);
+    }
+
+    return res;
+}
+
+int CHidRecorder::Write(const unsigned char *buf, size_t len)
+{
+    int res = live->Write(buf, len);
+    if(res > 0){
+        Record(CAPTURE_OUTPUT, buf, res);
+    }
+
+    return res;
+}
+
+bool CHidRecorder::GetManufacturer(char *str, size_t len)
+{
+    return live->GetManufacturer(str, len);
+}
+
+bool CHidRecorder::GetProduct(char *str, size_t len)
+{
+    return live->GetProduct(str, len);
+}
+
+
+CHidInstrumented::CHidInstrumented(CHidTransport *inner, CBusStats &stats) : stats(stats)
+{
+    this->inner = inner;
+}
+
+CHidInstrumented::~CHidInstrumented()
+{
+    delete inner;
+}
+
+bool CHidInstrumented::Open()
+{
+    return inner->Open();
+}
+
+void CHidInstrumented::Close()
+{
+    inner->Close();
+}
+
+int CHidInstrumented::Read(unsigned char *buf, size_t len, int timeoutMs)
+{
+    unsigned long long start = MonotonicUs();
+
+    int res = inner->Read(buf, len, timeoutMs);
+    if(res != 0){
+        stats.Record(HID_INPUT_REPORT, MonotonicUs() - start, res > 0);
+    }
+
+    return res;
+}
+
+int CHidInstrumented::Write(const unsigned char *buf, size_t len)
+{
+    unsigned long long start = MonotonicUs();
+
+    int res = inner->Write(buf, len);
+    stats.Record(len > 1 ? buf[1] : 0, MonotonicUs() - start, res == (int)len);
+
+    return res;
+}
+
+bool CHidInstrumented::GetManufacturer(char *str, size_t len)
+{
+    return inner->GetManufacturer(str, len);
+}
+
+bool CHidInstrumented::GetProduct(char *str, size_t len)
+{
+    return inner->GetProduct(str, len);
+}
+
+
+CHidReplay::CHidReplay(const char *path, double speed)
+{
+    strncpy(this->path, path, sizeof(this->path) - 1);
+    this->path[sizeof(this->path) - 1] = 0;
+    this->speed = speed;
+
+    fp = NULL;
+    startUs = 0;
+    recordUs = 0;
+    pendingLen = 0;
+
+    played = 0;
+    writes = 0;
+}
+
+CHidReplay::~CHidReplay()
+{
+    Close();
+}
+
+bool CHidReplay::Open()
+{
+    fp = fopen(path, "rb");
+    if(fp == NULL){
+        return false;
+    }
+
+    unsigned char header[6];
+    if(fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+       memcmp(header, CAPTURE_MAGIC, 4) != 0 || header[4] != CAPTURE_VERSION){
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+
+    startUs = MonotonicUs();
+    recordUs = 0;
+    pendingLen = 0;
+    played = 0;
+
+    return true;
+}
+
+void CHidReplay::Close()
+{
+    if(fp != NULL){
+        fclose(fp);
+        fp = NULL;
+    }
+}
+
+// Step through the capture to the next input report, accumulating the
+// recorded time as we go.
+bool CHidReplay::NextInput(unsigned char *buf, size_t len, int *length)
+{
+    int c;
+
+    while((c = fgetc(fp)) != EOF){
+        unsigned char direction = c;
+        unsigned long long delta = 0;
+        int shift = 0;
+
+        do {
+            if((c = fgetc(fp)) == EOF){
+                return false;
+            }
+            delta |= (unsigned long long)(c & 0x7f) << shift;
+            shift += 7;
+        } while(c & 0x80);
+
+        recordUs += delta;
+
+        int n = fgetc(fp);
+        if(n == EOF || n > REPORT_SIZE){
+            return false;
+        }
+
+        unsigned char report[REPORT_SIZE];
+        memset(report, 0, sizeof(report));
+        if(fread(report, 1, n, fp) != (size_t)n){
+            return false;
+        }
+
+        if(direction == CAPTURE_INPUT){
+            size_t copy = len < REPORT_SIZE ? len : REPORT_SIZE;
+            memcpy(buf, report, copy);
+            *length = copy;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int CHidReplay::Read(unsigned char *buf, size_t len, int timeoutMs)
+{
+    if(fp == NULL){
+        return -1;
+    }
+
+    // Once the capture runs out the device just goes quiet
+    if(pendingLen == 0 && !NextInput(pending, sizeof(pending), &pendingLen)){
+        usleep(timeoutMs * 1000);
+        return 0;
+    }
+
+    if(speed > 0){
+        unsigned long long due = startUs + (unsigned long long)(recordUs / speed);
+        unsigned long long now = MonotonicUs();
+
+        // Not due yet; keep it for the next call
+        if(due > now + timeoutMs * 1000ULL){
+            usleep(timeoutMs * 1000);
+            return 0;
+        }
+
+        if(due > now){
+            usleep(due - now);
+        }
+    }
+
+    int length = len < (size_t)pendingLen ? len : pendingLen;
+    memcpy(buf, pending, length);
+    pendingLen = 0;
+
+    played++;
+    return length;
+}
+
+// The capture's output reports are skipped by NextInput on the reader
+// thread, so a write has nothing to be checked against.
+int CHidReplay::Write(const unsigned char *, size_t len)
+{
+    writes++;
+    return len;
+}
+
+bool CHidReplay::GetManufacturer(char *str, size_t len)
+{
+    snprintf(str, len, "Replay");
+    return true;
+}
+
+bool CHidReplay::GetProduct(char *str, size_t len)
+{
+    snprintf(str, len, "%s", path);
+    return true;
+}
@@ -0,0 +1,226 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef HID_TRANSPORT_H
+#define HID_TRANSPORT_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <atomic>
+
+#include "hidapi.h"
+#include "bus-stats.h"
+
+#define GRB_VID 0x4d8
+#define GRB_PID 0x3f
+
+// Moves 64 byte reports to and from a GRBSystems controller, or
+// something pretending to be one.
+class CHidTransport
+{
+public:
+    virtual ~CHidTransport() {}
+
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+
+    // Bytes read, 0 if nothing arrived within timeoutMs, -1 on error.
+    virtual int Read(unsigned char *buf, size_t len, int timeoutMs) = 0;
+    // Bytes written, -1 on error.
+    virtual int Write(const unsigned char *buf, size_t len) = 0;
+
+    virtual bool GetManufacturer(char *str, size_t len) = 0;
+    virtual bool GetProduct(char *str, size_t len) = 0;
+
+    // A descriptor that polls readable when a report may be waiting, or
+    // -1 if the transport has none and must be read on a timer.
+    virtual int PollFd() { return -1; }
+};
+
+// The real device through hidapi.  hidapi keeps its descriptor to
+// itself, so this transport has no PollFd.
+class CHidApiTransport : public CHidTransport
+{
+public:
+    // An empty serial takes the first controller not already open in
+    // this process
+    CHidApiTransport(const char *serial);
+    ~CHidApiTransport();
+
+    bool Open();
+    void Close();
+
+    int Read(unsigned char *buf, size_t len, int timeoutMs);
+    int Write(const unsigned char *buf, size_t len);
+
+    bool GetManufacturer(char *str, size_t len);
+    bool GetProduct(char *str, size_t len);
+
+    // Serial numbers of every attached controller, comma separated
+    static void List(char *str, size_t len);
+
+private:
+    hid_device *handle;
+    char serial[64];
+    char path[256];
+};
+
+// The real device straight through Linux hidraw, without hidapi.  The
+// descriptor is non-blocking, so reads and writes wait at most their
+// timeout, and a controller that goes away makes PollFd readable and
+// the next Read fail at once.
+class CHidRawTransport : public CHidTransport
+{
+public:
+    // An empty serial takes the first controller not already open in
+    // this process
+    CHidRawTransport(const char *serial);
+    ~CHidRawTransport();
+
+    bool Open();
+    void Close();
+
+    int Read(unsigned char *buf, size_t len, int timeoutMs);
+    int Write(const unsigned char *buf, size_t len);
+
+    bool GetManufacturer(char *str, size_t len);
+    bool GetProduct(char *str, size_t len);
+
+    int PollFd() { return fd; }
+
+    // Serial numbers of every attached controller, comma separated
+    static void List(char *str, size_t len);
+
+private:
+    int fd;
+    char serial[64];
+    char path[256];
+    // hidrawN, for finding the device in sysfs
+    char node[32];
+    char name[128];
+
+    bool ReadAttribute(const char *attribute, char *str, size_t len);
+};
+
+// Capture file layout: "GRBH", version byte, report size byte, then one
+// record per report: direction byte, varint microseconds since the
+// previous record, length byte and the report with trailing zeros
+// dropped.
+#define CAPTURE_MAGIC    "GRBH"
+#define CAPTURE_VERSION  1
+#define CAPTURE_INPUT    0x01
+#define CAPTURE_OUTPUT   0x02
+
+// Passes everything through to another transport and logs it
+class CHidRecorder : public CHidTransport
+{
+public:
+    // Takes ownership of the wrapped transport
+    CHidRecorder(CHidTransport *live, const char *path);
+    ~CHidRecorder();
+
+    bool Open();
+    void Close();
+
+    int Read(unsigned char *buf, size_t len, int timeoutMs);
+    int Write(const unsigned char *buf, size_t len);
+
+    bool GetManufacturer(char *str, size_t len);
+    bool GetProduct(char *str, size_t len);
+
+    int PollFd() { return live->PollFd(); }
+
+private:
+    CHidTransport *live;
+    char path[256];
+    FILE *fp;
+
+    // Reads and writes happen on different threads
+    pthread_mutex_t lock;
+    unsigned long long lastUs;
+
+    void Record(unsigned char direction, const unsigned char *buf, size_t len);
+};
+
+// Stats key for input reports; output reports are keyed by their
+// command byte.
+#define HID_INPUT_REPORT 0x100
+
+// Passes everything through to another transport and times every read
+// and write into a CBusStats.  Reads that time out are not counted.
+class CHidInstrumented : public CHidTransport
+{
+public:
+    // Takes ownership of the wrapped transport, not of the stats
+    CHidInstrumented(CHidTransport *inner, CBusStats &stats);
+    ~CHidInstrumented();
+
+    bool Open();
+    void Close();
+
+    int Read(unsigned char *buf, size_t len, int timeoutMs);
+    int Write(const unsigned char *buf, size_t len);
+
+    bool GetManufacturer(char *str, size_t len);
+    bool GetProduct(char *str, size_t len);
+
+    int PollFd() { return inner->PollFd(); }
+
+private:
+    CHidTransport *inner;
+    CBusStats &stats;
+};
+
+// Plays back the input reports of a capture.  A speed of 2 plays twice
+// as fast as recorded, 0 as fast as the reader will take them.  Writes
+// are accepted and counted but do not affect what is played.
+class CHidReplay : public CHidTransport
+{
+public:
+    CHidReplay(const char *path, double speed);
+    ~CHidReplay();
+
+    bool Open();
+    void Close();
+
+    int Read(unsigned char *buf, size_t len, int timeoutMs);
+    int Write(const unsigned char *buf, size_t len);
+
+    bool GetManufacturer(char *str, size_t len);
+    bool GetProduct(char *str, size_t len);
+
+    unsigned long Played() const { return played; }
+    unsigned long Writes() const { return writes; }
+
+private:
+    char path[256];
+    double speed;
+    FILE *fp;
+
+    unsigned long long startUs;
+    unsigned long long recordUs;
+
+    unsigned char pending[64];
+    int pendingLen;
+
+    unsigned long played;
+    std::atomic<unsigned long> writes;
+
+    bool NextInput(unsigned char *buf, size_t len, int *length);
+};
+
+#endif
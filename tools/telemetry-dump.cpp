@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry-log.h"
+
+// Decodes a focuser telemetry log to CSV on stdout, oldest record first.
+//
+//   focus_telemetry_dump <log> [--monotonic]
+//
+// Times are wall clock seconds unless --monotonic is given, in which
+// case they are the driver's monotonic microseconds.
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "--monotonic") != 0))
+	{
+		fprintf(stderr, "usage: %s <log> [--monotonic]\n", argv[0]);
+		return 2;
+	}
+
+	bool monotonic = argc == 3;
+
+	CTelemetryReader reader;
+	if (!reader.Open(argv[1]))
+	{
+		fprintf(stderr, "%s: not a telemetry log\n", argv[1]);
+		return 1;
+	}
+
+	const TELEMETRY_HEADER &header = reader.Header();
+
+	printf("# %.*s\n", (int)sizeof(header.source), header.source);
+	printf(monotonic ? "monotonic_us" : "time");
+	for (uint32_t i = 0; i < header.fields; i++)
+	{
+		printf(",%.*s", TELEMETRY_NAME_SIZE, header.names[i]);
+	}
+	printf("\n");
+
+	unsigned long long us;
+	long values[TELEMETRY_MAX_FIELDS];
+
+	while (reader.Next(us, values))
+	{
+		if (monotonic)
+		{
+			printf("%llu", us);
+		}
+		else
+		{
+			long long wall = reader.WallUs(us);
+			printf("%lld.%06lld", wall / 1000000, wall % 1000000);
+		}
+
+		for (uint32_t i = 0; i < header.fields; i++)
+		{
+			printf(",%ld", values[i]);
+		}
+		printf("\n");
+	}
+
+	return 0;
+}